@@ -0,0 +1,156 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+// Nodes searched between updates of the shared node counter
+constexpr uint64_t kSliceNodes = 1 << 16;
+
+bool isBlank(const std::string& line)
+{
+  return line.find_first_not_of(" \t\r") == std::string::npos;
+}
+}
+
+std::vector<BatchMask> loadBatchFile(const std::filesystem::path& file,
+                                     int boardWidth, int boardHeight)
+{
+  std::ifstream in(file);
+  if (!in) {
+    throw std::runtime_error("Failed to open batch file: " + file.string());
+  }
+
+  const size_t numCells = static_cast<size_t>(boardWidth) * static_cast<size_t>(boardHeight);
+  std::vector<BatchMask> masks;
+  BatchMask block;     // mask rows read so far
+  int blockRows = 0;
+  int lineNumber = 0;
+
+  auto where = [&]() { return file.string() + ":" + std::to_string(lineNumber) + ": "; };
+
+  auto finishBlock = [&]() {
+    if (blockRows == 0) return;
+    if (blockRows != boardHeight) {
+      throw std::runtime_error(where() + "mask has " + std::to_string(blockRows) +
+                               " rows, expected " + std::to_string(boardHeight));
+    }
+    masks.push_back(std::move(block));
+    block = BatchMask{};
+    blockRows = 0;
+  };
+
+  std::string line;
+  while (std::getline(in, line)) {
+    ++lineNumber;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (isBlank(line)) {
+      finishBlock();
+      continue;
+    }
+    if (line[0] == '#') continue;
+
+    if (line.find(',') != std::string::npos) {
+      finishBlock();
+      BatchMask entry{line, std::vector<bool>(numCells, true)};
+      std::istringstream coords(line);
+      int x = 0, y = 0;
+      char comma = 0;
+      while (coords >> x >> comma >> y) {
+        if (comma != ',' || x < 0 || x >= boardWidth || y < 0 || y >= boardHeight) {
+          throw std::runtime_error(where() + "bad hole coordinate");
+        }
+        entry.mask[static_cast<size_t>(y * boardWidth + x)] = false;
+      }
+      if (!coords.eof()) {
+        throw std::runtime_error(where() + "expected x,y pairs");
+      }
+      masks.push_back(std::move(entry));
+      continue;
+    }
+
+    if (static_cast<int>(line.size()) != boardWidth ||
+        line.find_first_not_of("01") != std::string::npos) {
+      throw std::runtime_error(where() + "mask rows must be " + std::to_string(boardWidth) +
+                               " characters of 0 and 1");
+    }
+    if (blockRows == 0) {
+      block.label = "mask at line " + std::to_string(lineNumber);
+      block.mask.assign(numCells, true);
+    }
+    else if (blockRows == boardHeight) {
+      throw std::runtime_error(where() + "mask has more than " + std::to_string(boardHeight) + " rows");
+    }
+    for (int x = 0; x < boardWidth; ++x) {
+      block.mask[static_cast<size_t>(blockRows * boardWidth + x)] = (line[x] == '1');
+    }
+    ++blockRows;
+  }
+  finishBlock();
+  return masks;
+}
+
+std::vector<BatchResult> solveBatch(const DLX& prototype,
+                                    const std::vector<bool>& prototypeMask,
+                                    const std::vector<BatchMask>& masks, int numThreads,
+                                    const std::function<void(size_t, const BatchResult&)>& onResult)
+{
+  std::vector<BatchResult> results(masks.size());
+  std::atomic<size_t> next{0};
+  std::mutex resultMutex;
+  std::atomic<uint64_t>* const sharedNodes = prototype.p_nodesVisited;
+
+  auto worker = [&]() {
+    DLX dlx = prototype;
+    std::atomic<uint64_t> nodes{0};
+    dlx.p_nodesVisited = &nodes;
+
+    for (size_t i = next++; i < masks.size(); i = next++) {
+      std::vector<int> holes;
+      for (size_t cell = 0; cell < prototypeMask.size(); ++cell) {
+        if (prototypeMask[cell] && !masks[i].mask[cell]) holes.push_back(static_cast<int>(cell));
+      }
+
+      const auto t0 = std::chrono::steady_clock::now();
+      uint64_t reported = 0;
+      dlx.removeCells(holes);
+      dlx.beginSearch();
+      bool more = true;
+      while (more) {
+        more = dlx.countStep(kSliceNodes);
+        const uint64_t n = nodes.load();
+        if (sharedNodes) sharedNodes->fetch_add(n - reported);
+        reported = n;
+      }
+      dlx.restoreCells(holes);
+
+      BatchResult& r = results[i];
+      r.solutions = dlx.solutionCount();
+      r.nodes = nodes.exchange(0);
+      r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      r.finished = !(dlx.p_stopFlag && dlx.p_stopFlag->load());
+
+      std::lock_guard<std::mutex> lock(resultMutex);
+      if (onResult) onResult(i, r);
+      if (!r.finished) break;
+    }
+  };
+
+  const int numWorkers = std::max(1, std::min(numThreads, static_cast<int>(masks.size())));
+  std::vector<std::thread> workers;
+  for (int i = 1; i < numWorkers; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : workers) {
+    t.join();
+  }
+  return results;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "dlx.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+// One board variant of a batch run
+struct BatchMask
+{
+  std::string label;
+  std::vector<bool> mask;  // true = allowed cell, false = hole
+};
+
+// A batch file lists one variant per entry. An entry is either a block of
+// '0'/'1' rows (like --board-mask), ended by a blank line, or a single line
+// of x,y hole coordinates ("3,3 3,4 4,3 4,4"). Lines starting with '#' are
+// comments. Throws std::runtime_error on malformed input.
+std::vector<BatchMask> loadBatchFile(const std::filesystem::path& file,
+                                     int boardWidth, int boardHeight);
+
+struct BatchResult
+{
+  uint64_t solutions = 0;
+  uint64_t nodes = 0;
+  double seconds = 0.0;
+  bool finished = false;  // false if the stop flag cut the search short
+};
+
+// Count the solutions of every mask on copies of 'prototype', which must be
+// set up on a board that allows every cell any mask allows. Each variant
+// removes its hole cells from the shared matrix and restores them afterwards,
+// so placements are enumerated once for all masks. Masks are handed out to
+// numThreads workers; onResult(index, result) is called as soon as a mask is
+// done, serialized across workers.
+std::vector<BatchResult> solveBatch(const DLX& prototype,
+                                    const std::vector<bool>& prototypeMask,
+                                    const std::vector<BatchMask>& masks, int numThreads,
+                                    const std::function<void(size_t, const BatchResult&)>& onResult);
@@ -0,0 +1,388 @@
+#pragma once
+
+#include "dlx.h"
+#include "shapes.h"
+#include "zdd.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+inline int lowestSetBit(uint64_t x)
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(x);
+#endif
+}
+
+// Fixed-size bit set over the usable board cells
+template <int Words>
+struct Bits
+{
+  uint64_t w[Words] = {};
+
+  void set(int i) { w[i >> 6] |= uint64_t{1} << (i & 63); }
+  bool test(int i) const { return (w[i >> 6] >> (i & 63)) & 1; }
+
+  bool intersects(const Bits& o) const {
+    uint64_t acc = 0;
+    for (int k = 0; k < Words; ++k) acc |= w[k] & o.w[k];
+    return acc != 0;
+  }
+
+  Bits operator|(const Bits& o) const {
+    Bits r;
+    for (int k = 0; k < Words; ++k) r.w[k] = w[k] | o.w[k];
+    return r;
+  }
+
+  bool operator==(const Bits& o) const {
+    for (int k = 0; k < Words; ++k) if (w[k] != o.w[k]) return false;
+    return true;
+  }
+
+  // Index of the lowest bit that is set in 'within' but not here (-1 if none)
+  int firstClear(const Bits& within) const {
+    for (int k = 0; k < Words; ++k) {
+      const uint64_t free = within.w[k] & ~w[k];
+      if (free) return 64 * k + lowestSetBit(free);
+    }
+    return -1;
+  }
+};
+
+// Exact-cover search for boards with at most 64 * Words usable cells and at
+// most 64 pieces. Every placement is a bit mask over the usable cells plus one
+// piece bit. The search always fills the lowest empty cell, so each cell keeps
+// the list of placements whose lowest cell it is, and a fit test is one AND
+// per word. Placements and solution rows are the same as for DLX.
+template <int Words>
+class BitboardSolver
+{
+public:
+  static constexpr int kMaxCells = 64 * Words;
+  static constexpr int kMaxPieces = 64;
+
+  // external control/monitoring hooks
+  std::function<void(const std::vector<int>&)> handleSolution;
+  std::atomic<uint64_t>* p_nodesVisited = nullptr;
+  std::atomic<uint64_t>* p_solutionsFound = nullptr;
+  std::atomic<bool>* p_stopFlag = nullptr;
+
+  static bool fits(const std::vector<bool>& boardMask, int numPieces) {
+    int cells = 0;
+    for (bool b : boardMask) cells += b ? 1 : 0;
+    return cells <= kMaxCells && numPieces <= kMaxPieces;
+  }
+
+  void setup(const std::vector<Placement>& placements,
+             const std::vector<bool>& boardMask,
+             int boardWidth, int boardHeight, int numPieces,
+             bool optionalPieces = false)
+  {
+    // Number the usable cells along the short side first, so "lowest empty
+    // cell" sweeps the board across its long axis
+    std::vector<int> boardCellToBit(static_cast<size_t>(boardWidth * boardHeight), -1);
+    int numCells = 0;
+    const bool columnMajor = boardWidth > boardHeight;
+    const int outer = columnMajor ? boardWidth : boardHeight;
+    const int inner = columnMajor ? boardHeight : boardWidth;
+    for (int o = 0; o < outer; ++o) {
+      for (int i = 0; i < inner; ++i) {
+        const int idx = columnMajor ? (i * boardWidth + o) : (o * boardWidth + i);
+        if (boardMask[idx]) boardCellToBit[idx] = numCells++;
+      }
+    }
+
+    m_board = Bits<Words>{};
+    for (int b = 0; b < numCells; ++b) m_board.set(b);
+    const uint64_t allPieces = (numPieces >= 64) ? ~uint64_t{0} : ((uint64_t{1} << numPieces) - 1);
+    m_requiredPieces = optionalPieces ? 0 : allPieces;
+
+    m_candidates.assign(static_cast<size_t>(numCells), {});
+    for (size_t i = 0; i < placements.size(); ++i) {
+      const Placement& pl = placements[i];
+      Candidate cand;
+      cand.piece = uint64_t{1} << pl.pieceID;
+      cand.rowID = static_cast<int>(i);
+
+      int lowest = numCells;
+      bool placementValid = true;
+      for (int cell : pl.cells) {
+        const int bit = boardCellToBit[cell];
+        if (bit == -1) {
+          placementValid = false;
+          break;
+        }
+        cand.cells.set(bit);
+        if (bit < lowest) lowest = bit;
+      }
+
+      if (!placementValid) continue;
+      m_candidates[static_cast<size_t>(lowest)].push_back(cand);
+    }
+
+    // ZDD variables follow the candidate order, so they increase along every
+    // search path
+    m_varRows.clear();
+    m_numPlacements = placements.size();
+    for (auto& list : m_candidates) {
+      for (Candidate& cand : list) {
+        cand.var = static_cast<uint32_t>(m_varRows.size());
+        m_varRows.push_back(cand.rowID);
+      }
+    }
+  }
+
+  // The search fills cells in a fixed order, so the anchors of its placements
+  // increase along every path. Ordering identical copies by anchor therefore
+  // means a copy may only be used once the previous copy is: every candidate
+  // of piece p also needs the bit of previousCopy[p]. Unlike the DLX copy
+  // order this depends on the used pieces alone, so memoized counts stay valid.
+  void setIdenticalPieces(const std::vector<Placement>&, const std::vector<int>& previousCopy) {
+    for (auto& list : m_candidates) {
+      for (Candidate& cand : list) {
+        const int prev = previousCopy[static_cast<size_t>(lowestSetBit(cand.piece))];
+        cand.needs = (prev < 0) ? 0 : (uint64_t{1} << prev);
+      }
+    }
+  }
+
+  // Branching is always on the lowest empty cell; the heuristic is accepted
+  // for interface compatibility with DLX.
+  void setHeuristic(HeuristicMode) {}
+
+  void search() {
+    m_rows.clear();
+    searchFrom<false>(Bits<Words>{}, 0);
+  }
+
+  // Memoized counting: subtree counts are cached in a transposition table
+  // keyed on (filled cells, used pieces), bounded to maxBytes. Because the
+  // search always fills the lowest empty cell, that pair fully determines the
+  // remaining subproblem. 0 disables the table.
+  void setMemoTableSize(size_t maxBytes) {
+    size_t entries = 2;
+    while (entries * 2 * sizeof(MemoEntry) <= maxBytes) entries *= 2;
+    m_memo.assign(maxBytes >= 2 * sizeof(MemoEntry) ? entries : 0, MemoEntry{});
+    m_memoStats = MemoStats{};
+  }
+
+  struct MemoStats
+  {
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t stores = 0;
+    uint64_t replacements = 0;
+  };
+
+  const MemoStats& memoStats() const { return m_memoStats; }
+  size_t memoTableBytes() const { return m_memo.size() * sizeof(MemoEntry); }
+
+  uint64_t countSolutions() {
+    m_count = countFrom(Bits<Words>{}, 0);
+    if (p_solutionsFound) p_solutionsFound->fetch_add(m_count);
+    return m_count;
+  }
+
+  // Count the subtree below each placement covering the first cell
+  uint64_t countSolutionsPerBranch(const std::function<void(int, uint64_t)>& onBranch) {
+    const int cell = Bits<Words>{}.firstClear(m_board);
+    if (cell < 0) return countSolutions();
+
+    if (p_nodesVisited) p_nodesVisited->fetch_add(1);
+    uint64_t total = 0;
+    for (const Candidate& cand : m_candidates[static_cast<size_t>(cell)]) {
+      if (cand.needs) continue;
+      m_count = countFrom(cand.cells, cand.piece);
+      if (p_solutionsFound) p_solutionsFound->fetch_add(m_count);
+      total += m_count;
+      if (onBranch) onBranch(cand.rowID, m_count);
+    }
+    return total;
+  }
+
+  // Build a ZDD of every solution. Equal (filled cells, used pieces) states
+  // share one node, so the diagram is usually far smaller than the list of
+  // solutions. Returns false if the stop flag interrupted the build.
+  bool buildZDD(ZDD& zdd) {
+    zdd = ZDD{};
+    zdd.setVariables(m_varRows, m_numPlacements);
+    std::unordered_map<StateKey, ZDD::NodeID, StateKeyHash> states;
+    zdd.setRoot(zddFrom(zdd, states, Bits<Words>{}, 0));
+    return !(p_stopFlag && p_stopFlag->load());
+  }
+
+private:
+  struct Candidate
+  {
+    Bits<Words> cells;
+    uint64_t piece;
+    uint64_t needs = 0;  // piece bits that must already be used
+    int rowID;
+    uint32_t var = 0;
+  };
+
+  struct StateKey
+  {
+    Bits<Words> filled;
+    uint64_t used;
+    bool operator==(const StateKey& o) const { return used == o.used && filled == o.filled; }
+  };
+
+  struct StateKeyHash
+  {
+    size_t operator()(const StateKey& k) const { return static_cast<size_t>(stateHash(k.filled, k.used)); }
+  };
+
+  static uint64_t stateHash(const Bits<Words>& filled, uint64_t used) {
+    uint64_t h = used * 0x9E3779B97F4A7C15ull;
+    for (int k = 0; k < Words; ++k) {
+      h ^= filled.w[k] + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    }
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 29;
+    return h;
+  }
+
+  Bits<Words> m_board;  // usable cells
+  uint64_t m_requiredPieces = 0;  // pieces every solution must use
+  std::vector<std::vector<Candidate>> m_candidates; // by lowest cell
+  std::vector<int> m_rows;
+  uint64_t m_count = 0;
+  std::vector<int> m_varRows;  // ZDD variable -> row ID
+  size_t m_numPlacements = 0;
+
+  // Transposition table, two-way set associative. 'work' is the number of
+  // nodes it took to compute the entry (0 = empty slot); the cheaper of the
+  // two slots is replaced.
+  struct MemoEntry
+  {
+    Bits<Words> filled;
+    uint64_t used = 0;
+    uint64_t count = 0;
+    uint64_t work = 0;
+  };
+
+  static constexpr uint64_t kMinMemoWork = 4;
+
+  std::vector<MemoEntry> m_memo;
+  MemoStats m_memoStats;
+
+  size_t memoBucket(const Bits<Words>& filled, uint64_t used) const {
+    return static_cast<size_t>(stateHash(filled, used)) & (m_memo.size() - 2);
+  }
+
+  // ZDD node for the subproblem (filled, used). The candidates for the lowest
+  // empty cell are chained through lo edges, last candidate at the bottom.
+  ZDD::NodeID zddFrom(ZDD& zdd, std::unordered_map<StateKey, ZDD::NodeID, StateKeyHash>& states,
+                      const Bits<Words>& filled, uint64_t used) {
+    if (p_stopFlag && p_stopFlag->load(std::memory_order_relaxed)) return ZDD::kEmpty;
+
+    const int cell = filled.firstClear(m_board);
+    if (cell < 0) return (used & m_requiredPieces) == m_requiredPieces ? ZDD::kUnit : ZDD::kEmpty;
+
+    const StateKey key{filled, used};
+    const auto it = states.find(key);
+    if (it != states.end()) return it->second;
+
+    if (p_nodesVisited) p_nodesVisited->fetch_add(1);
+    ZDD::NodeID node = ZDD::kEmpty;
+    const std::vector<Candidate>& list = m_candidates[static_cast<size_t>(cell)];
+    for (auto cand = list.rbegin(); cand != list.rend(); ++cand) {
+      if ((cand->piece & used) || (cand->needs & ~used) || cand->cells.intersects(filled)) continue;
+      const ZDD::NodeID hi = zddFrom(zdd, states, filled | cand->cells, used | cand->piece);
+      node = zdd.makeNode(cand->var, node, hi);
+    }
+
+    states.emplace(key, node);
+    return node;
+  }
+
+  uint64_t countFrom(const Bits<Words>& filled, uint64_t used) {
+    if (m_memo.empty()) {
+      m_count = 0;
+      searchFrom<true>(filled, used);
+      return m_count;
+    }
+    uint64_t work = 0;
+    return countMemo(filled, used, work);
+  }
+
+  // Count the subtree below (filled, used); adds its node count to 'work'
+  uint64_t countMemo(const Bits<Words>& filled, uint64_t used, uint64_t& work) {
+    if (p_stopFlag && p_stopFlag->load(std::memory_order_relaxed)) return 0;
+
+    const int cell = filled.firstClear(m_board);
+    if (cell < 0) return (used & m_requiredPieces) == m_requiredPieces ? 1 : 0;
+
+    const size_t bucket = memoBucket(filled, used);
+    ++m_memoStats.lookups;
+    for (size_t slot = bucket; slot < bucket + 2; ++slot) {
+      const MemoEntry& e = m_memo[slot];
+      if (e.work != 0 && e.used == used && e.filled == filled) {
+        ++m_memoStats.hits;
+        return e.count;
+      }
+    }
+
+    if (p_nodesVisited) p_nodesVisited->fetch_add(1);
+    uint64_t count = 0;
+    uint64_t subtreeWork = 1;
+    for (const Candidate& cand : m_candidates[static_cast<size_t>(cell)]) {
+      if ((cand.piece & used) || (cand.needs & ~used) || cand.cells.intersects(filled)) continue;
+      count += countMemo(filled | cand.cells, used | cand.piece, subtreeWork);
+    }
+    work += subtreeWork;
+
+    // A stopped search leaves partial counts; do not cache them. Tiny
+    // subtrees are cheaper to recompute than to keep in the table.
+    if (p_stopFlag && p_stopFlag->load(std::memory_order_relaxed)) return count;
+    if (subtreeWork < kMinMemoWork) return count;
+
+    MemoEntry& a = m_memo[bucket];
+    MemoEntry& b = m_memo[bucket + 1];
+    MemoEntry& victim = (a.work <= b.work) ? a : b;
+    if (victim.work != 0) ++m_memoStats.replacements;
+    ++m_memoStats.stores;
+    victim = MemoEntry{filled, used, count, subtreeWork};
+    return count;
+  }
+
+  template <bool CountOnly>
+  void searchFrom(const Bits<Words>& filled, uint64_t used) {
+    if (p_stopFlag && p_stopFlag->load(std::memory_order_relaxed)) return;
+
+    const int cell = filled.firstClear(m_board);
+    if (cell < 0) {
+      if ((used & m_requiredPieces) != m_requiredPieces) return;
+      if constexpr (CountOnly) {
+        ++m_count;
+      }
+      else {
+        if (handleSolution) handleSolution(m_rows);
+        if (p_solutionsFound) p_solutionsFound->fetch_add(1);
+      }
+      return;
+    }
+    if (p_nodesVisited) p_nodesVisited->fetch_add(1);
+
+    for (const Candidate& cand : m_candidates[static_cast<size_t>(cell)]) {
+      if ((cand.piece & used) || (cand.needs & ~used) || cand.cells.intersects(filled)) continue;
+      if constexpr (!CountOnly) m_rows.push_back(cand.rowID);
+      searchFrom<CountOnly>(filled | cand.cells, used | cand.piece);
+      if constexpr (!CountOnly) m_rows.pop_back();
+    }
+  }
+};
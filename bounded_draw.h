@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+
+// Uniform integer in [0, bound), bound > 0. Unlike
+// std::uniform_int_distribution, whose algorithm is up to the standard
+// library, this gives the same draws on every platform, so seeded runs
+// (probe-based shard splits, ZDD samples) agree between machines.
+inline uint64_t boundedDraw(std::mt19937_64& rng, uint64_t bound)
+{
+  const uint64_t threshold = (0 - bound) % bound;
+  uint64_t x = rng();
+  while (x < threshold) x = rng();
+  return x % bound;
+}
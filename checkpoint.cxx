@@ -0,0 +1,133 @@
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+constexpr const char* kHeader = "tessellinx-checkpoint 2";
+
+// FNV-1a
+void hashValue(uint64_t& h, uint64_t v)
+{
+  for (int i = 0; i < 8; ++i) {
+    h ^= (v >> (8 * i)) & 0xFF;
+    h *= 0x100000001B3ull;
+  }
+}
+
+template <typename T>
+T readField(std::istream& in, const std::string& name)
+{
+  std::string key;
+  T value{};
+  if (!(in >> key >> value) || key != name) {
+    throw std::runtime_error("Malformed checkpoint: expected '" + name + "'");
+  }
+  return value;
+}
+
+// Force the file's data to disk
+bool syncFile(std::FILE* f)
+{
+#ifdef _WIN32
+  return _commit(_fileno(f)) == 0;
+#else
+  return fsync(fileno(f)) == 0;
+#endif
+}
+}
+
+uint64_t puzzleFingerprint(const std::vector<Placement>& placements,
+                           const std::vector<bool>& boardMask,
+                           int boardWidth, int boardHeight, int heuristic,
+                           bool optionalPieces)
+{
+  uint64_t h = 0xCBF29CE484222325ull;
+  hashValue(h, static_cast<uint64_t>(boardWidth));
+  hashValue(h, static_cast<uint64_t>(boardHeight));
+  hashValue(h, static_cast<uint64_t>(heuristic));
+  hashValue(h, optionalPieces ? 1 : 0);
+  for (bool b : boardMask) hashValue(h, b ? 1 : 0);
+  hashValue(h, placements.size());
+  for (const Placement& pl : placements) {
+    hashValue(h, static_cast<uint64_t>(pl.pieceID));
+    for (int c : pl.cells) hashValue(h, static_cast<uint64_t>(c));
+  }
+  return h;
+}
+
+void saveCheckpoint(const Checkpoint& cp, const std::filesystem::path& file)
+{
+  std::ostringstream out;
+  out << kHeader << "\n"
+      << "fingerprint " << cp.fingerprint << "\n"
+      << "count-only " << (cp.countOnly ? 1 : 0) << "\n"
+      << "nodes " << cp.nodesVisited << "\n"
+      << "solutions " << cp.solutionsFound << "\n"
+      << "reported " << cp.solutionsReported << "\n"
+      << "csv-bytes " << cp.csvBytes << "\n"
+      << "path " << cp.path.size();
+  for (int r : cp.path) out << " " << r;
+  out << "\nunique " << cp.uniqueForms.size() << "\n";
+  for (const Fingerprint& form : cp.uniqueForms) out << form << "\n";
+  const std::string data = out.str();
+
+  // The data must be on disk before the rename, or a crash could leave the
+  // new name pointing at an empty or partial file. On any failure the
+  // previous checkpoint stays in place.
+  std::filesystem::path tmp = file;
+  tmp += ".tmp";
+  std::FILE* f = std::fopen(tmp.string().c_str(), "wb");
+  if (!f) throw std::runtime_error("Cannot write checkpoint: " + tmp.string());
+  bool written = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+  written = std::fflush(f) == 0 && written;
+  written = syncFile(f) && written;
+  written = std::fclose(f) == 0 && written;
+  if (!written) {
+    std::error_code ignored;
+    std::filesystem::remove(tmp, ignored);
+    throw std::runtime_error("Failed writing checkpoint: " + tmp.string());
+  }
+  std::filesystem::rename(tmp, file);
+}
+
+Checkpoint loadCheckpoint(const std::filesystem::path& file)
+{
+  std::ifstream in(file);
+  if (!in) throw std::runtime_error("Cannot open checkpoint: " + file.string());
+
+  std::string header;
+  if (!std::getline(in, header) || header != kHeader) {
+    throw std::runtime_error("Not a tessellinx checkpoint: " + file.string());
+  }
+
+  Checkpoint cp;
+  cp.fingerprint = readField<uint64_t>(in, "fingerprint");
+  cp.countOnly = readField<int>(in, "count-only") != 0;
+  cp.nodesVisited = readField<uint64_t>(in, "nodes");
+  cp.solutionsFound = readField<uint64_t>(in, "solutions");
+  cp.solutionsReported = readField<uint64_t>(in, "reported");
+  cp.csvBytes = readField<uint64_t>(in, "csv-bytes");
+
+  const size_t depth = readField<size_t>(in, "path");
+  cp.path.resize(depth);
+  for (int& r : cp.path) {
+    if (!(in >> r)) throw std::runtime_error("Malformed checkpoint: truncated path");
+  }
+
+  const size_t numForms = readField<size_t>(in, "unique");
+  cp.uniqueForms.resize(numForms);
+  for (Fingerprint& form : cp.uniqueForms) {
+    if (!(in >> form)) throw std::runtime_error("Malformed checkpoint: truncated dedup state");
+  }
+  return cp;
+}
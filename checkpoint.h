@@ -0,0 +1,37 @@
+#pragma once
+
+#include "fingerprint_set.h"
+#include "shapes.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Saved state of a single-threaded DLX search. The search position is the
+// row chosen at each depth; replaying it re-covers the same columns, after
+// which the search continues with the node it was about to enter.
+struct Checkpoint
+{
+  uint64_t fingerprint = 0;  // puzzleFingerprint() of the run that wrote it
+  bool countOnly = false;
+  uint64_t nodesVisited = 0;
+  uint64_t solutionsFound = 0;
+  uint64_t solutionsReported = 0;  // after the unique-solutions filter
+  uint64_t csvBytes = 0;           // CSV output length at the time of the checkpoint
+  std::vector<int> path;
+  std::vector<Fingerprint> uniqueForms;  // dedup state (canonical form fingerprints)
+};
+
+// Hash of everything that determines the search tree
+uint64_t puzzleFingerprint(const std::vector<Placement>& placements,
+                           const std::vector<bool>& boardMask,
+                           int boardWidth, int boardHeight, int heuristic,
+                           bool optionalPieces);
+
+// Written to a temporary file and renamed over 'file', so a crash while
+// saving leaves the previous checkpoint intact
+void saveCheckpoint(const Checkpoint& cp, const std::filesystem::path& file);
+
+// Throws std::runtime_error if the file is missing or malformed
+Checkpoint loadCheckpoint(const std::filesystem::path& file);
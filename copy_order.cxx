@@ -0,0 +1,94 @@
+#include "copy_order.h"
+
+#include <algorithm>
+#include <cstdint>
+
+void CopyOrder::setup(const std::vector<Placement>& placements, const std::vector<int>& previousCopy)
+{
+  m_prev = previousCopy;
+  m_next.assign(previousCopy.size(), -1);
+  m_active = false;
+  for (size_t p = 0; p < previousCopy.size(); ++p) {
+    if (previousCopy[p] < 0) continue;
+    m_next[static_cast<size_t>(previousCopy[p])] = static_cast<int>(p);
+    m_active = true;
+  }
+  m_anchor.assign(previousCopy.size(), -1);
+
+  m_rowPiece.resize(placements.size());
+  m_rowAnchor.resize(placements.size());
+  for (size_t i = 0; i < placements.size(); ++i) {
+    m_rowPiece[i] = placements[i].pieceID;
+    m_rowAnchor[i] = *std::min_element(placements[i].cells.begin(), placements[i].cells.end());
+  }
+}
+
+bool CopyOrder::usesFirstCopies() const
+{
+  for (size_t p = 0; p < m_prev.size(); ++p) {
+    if (m_prev[p] >= 0 && m_anchor[p] >= 0 && m_anchor[static_cast<size_t>(m_prev[p])] < 0) return false;
+  }
+  return true;
+}
+
+void CopyLabels::setup(const std::vector<Placement>& placements, const std::vector<int>& previousCopy)
+{
+  std::vector<int> shape(previousCopy.size());
+  std::vector<bool> hasCopies(previousCopy.size(), false);
+  for (size_t p = 0; p < previousCopy.size(); ++p) {
+    const int prev = previousCopy[p];
+    shape[p] = prev < 0 ? static_cast<int>(p) : shape[static_cast<size_t>(prev)];
+    if (prev >= 0) hasCopies[static_cast<size_t>(shape[p])] = true;
+  }
+
+  m_rowOf.clear();
+  m_rowShape.assign(placements.size(), -1);
+  m_rowPiece.assign(placements.size(), -1);
+  m_rowCells.assign(placements.size(), {});
+  for (size_t i = 0; i < placements.size(); ++i) {
+    const Placement& pl = placements[i];
+    const int s = shape[static_cast<size_t>(pl.pieceID)];
+    if (!hasCopies[static_cast<size_t>(s)] || pl.cells.empty()) continue;
+    m_rowShape[i] = s;
+    m_rowPiece[i] = pl.pieceID;
+    m_rowCells[i] = pl.cells;
+    std::sort(m_rowCells[i].begin(), m_rowCells[i].end());
+    m_rowOf.emplace(std::make_pair(pl.pieceID, m_rowCells[i]), static_cast<int>(i));
+  }
+}
+
+std::vector<int> CopyLabels::canonical(std::vector<int> rows) const
+{
+  if (m_rowOf.empty()) return rows;
+
+  std::vector<uint8_t> done(rows.size(), 0);
+  for (size_t j = 0; j < rows.size(); ++j) {
+    const int shape = m_rowShape[static_cast<size_t>(rows[j])];
+    if (shape < 0 || done[j]) continue;
+
+    // All rows using a copy of this shape
+    std::vector<size_t> slots;
+    std::vector<int> labels;
+    for (size_t i = j; i < rows.size(); ++i) {
+      const size_t row = static_cast<size_t>(rows[i]);
+      if (m_rowShape[row] != shape) continue;
+      slots.push_back(i);
+      labels.push_back(m_rowPiece[row]);
+      done[i] = 1;
+    }
+    std::sort(labels.begin(), labels.end());
+    std::sort(slots.begin(), slots.end(), [&](size_t a, size_t b) {
+      return m_rowCells[static_cast<size_t>(rows[a])].front() < m_rowCells[static_cast<size_t>(rows[b])].front();
+    });
+
+    std::vector<int> relabeled(slots.size());
+    for (size_t s = 0; s < slots.size(); ++s) {
+      const auto it = m_rowOf.find(std::make_pair(labels[s], m_rowCells[static_cast<size_t>(rows[slots[s]])]));
+      // A reduced placement list may lack the row; keep the engine's labels then
+      if (it == m_rowOf.end()) return rows;
+      relabeled[s] = it->second;
+    }
+    for (size_t s = 0; s < slots.size(); ++s) rows[slots[s]] = relabeled[s];
+  }
+  return rows;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "shapes.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+// Identical copies of a piece are interchangeable, so without an order every
+// tiling that uses them is found once per permutation of the copies.
+// CopyOrder numbers the copies of each shape and only lets copy k go to an
+// anchor (lowest board cell) above the anchor of copy k-1 and below that of
+// copy k+1, as far as those are placed. Checked whenever the second of two
+// neighboring copies is placed, this leaves one labeling per tiling. With
+// optional pieces the copies in use must also be the first ones of their
+// shape, which is only known at a solution (usesFirstCopies()).
+class CopyOrder
+{
+public:
+  // previousCopy[p] is the previous piece with the same shape as p, or -1.
+  // Row IDs are indices into 'placements'.
+  void setup(const std::vector<Placement>& placements, const std::vector<int>& previousCopy);
+
+  bool active() const { return m_active; }
+
+  bool allows(int rowID) const {
+    const int piece = m_rowPiece[static_cast<size_t>(rowID)];
+    const int anchor = m_rowAnchor[static_cast<size_t>(rowID)];
+    const int prev = m_prev[static_cast<size_t>(piece)];
+    const int next = m_next[static_cast<size_t>(piece)];
+    // Unplaced copies have anchor -1
+    return (prev < 0 || m_anchor[static_cast<size_t>(prev)] < anchor) &&
+           (next < 0 || m_anchor[static_cast<size_t>(next)] < 0 || m_anchor[static_cast<size_t>(next)] > anchor);
+  }
+
+  void place(int rowID) {
+    m_anchor[static_cast<size_t>(m_rowPiece[static_cast<size_t>(rowID)])] = m_rowAnchor[static_cast<size_t>(rowID)];
+  }
+  void unplace(int rowID) {
+    m_anchor[static_cast<size_t>(m_rowPiece[static_cast<size_t>(rowID)])] = -1;
+  }
+
+  bool usesFirstCopies() const;
+
+private:
+  bool m_active = false;
+  std::vector<int> m_rowPiece;   // by row ID
+  std::vector<int> m_rowAnchor;  // by row ID
+  std::vector<int> m_prev;       // by piece, -1 = first copy
+  std::vector<int> m_next;       // by piece, -1 = last copy
+  std::vector<int> m_anchor;     // by piece, anchor of the placed copy or -1
+};
+
+// Engines that number copies in their own fill order relabel their solutions
+// with this, so that the rows are the ones CopyOrder lets DLX find
+class CopyLabels
+{
+public:
+  void setup(const std::vector<Placement>& placements, const std::vector<int>& previousCopy);
+
+  bool active() const { return !m_rowOf.empty(); }
+
+  // The same tiling with the copies of every shape numbered by increasing anchor
+  std::vector<int> canonical(std::vector<int> rows) const;
+
+private:
+  std::vector<int> m_rowShape;               // first copy of the row's shape, -1 without copies
+  std::vector<int> m_rowPiece;
+  std::vector<std::vector<int>> m_rowCells;  // sorted board cells
+  std::map<std::pair<int, std::vector<int>>, int> m_rowOf;
+};
@@ -0,0 +1,391 @@
+#include "dancing_cells.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+void DancingCells::setup(const std::vector<Placement>& placements,
+                         const std::vector<bool>& boardMask,
+                         int boardWidth, int boardHeight,
+                         int numPieces, bool optionalPieces)
+{
+  std::vector<int> boardCellToItem(boardWidth * boardHeight, -1);
+  int numItems = 0;
+  for (int i = 0; i < boardWidth * boardHeight; ++i) {
+    if (boardMask[i]) boardCellToItem[i] = numItems++;
+  }
+  const int pieceItemsStart = numItems;
+  numItems += numPieces;
+
+  // Options, in placement order
+  m_optionStart.assign(1, 0);
+  m_optionRowID.clear();
+  m_nodeItem.clear();
+  std::vector<int> setCount(static_cast<size_t>(numItems), 0);
+
+  for (size_t i = 0; i < placements.size(); ++i) {
+    const Placement& pl = placements[i];
+    bool placementValid = true;
+    for (int cell : pl.cells) {
+      if (boardCellToItem[cell] == -1) {
+        placementValid = false;
+        break;
+      }
+    }
+    if (!placementValid) continue;
+
+    for (int cell : pl.cells) {
+      m_nodeItem.push_back(boardCellToItem[cell]);
+    }
+    m_nodeItem.push_back(pieceItemsStart + pl.pieceID);
+    for (int n = m_optionStart.back(); n < static_cast<int>(m_nodeItem.size()); ++n) {
+      setCount[static_cast<size_t>(m_nodeItem[n])]++;
+    }
+
+    m_optionStart.push_back(static_cast<int>(m_nodeItem.size()));
+    m_optionRowID.push_back(static_cast<int>(i));
+  }
+
+  const int numOptions = static_cast<int>(m_optionRowID.size());
+  const int numNodes = static_cast<int>(m_nodeItem.size());
+
+  m_optionStamp.assign(static_cast<size_t>(numOptions), 0);
+  m_stamp = 0;
+
+  m_nodeOption.resize(static_cast<size_t>(numNodes));
+  for (int o = 0; o < numOptions; ++o) {
+    for (int n = m_optionStart[o]; n < m_optionStart[o + 1]; ++n) {
+      m_nodeOption[n] = o;
+    }
+  }
+
+  // Item sets, laid out back to back
+  m_setStart.assign(static_cast<size_t>(numItems), 0);
+  for (int k = 1; k < numItems; ++k) {
+    m_setStart[k] = m_setStart[k - 1] + setCount[k - 1];
+  }
+  m_setSize.assign(static_cast<size_t>(numItems), 0);
+  m_set.assign(static_cast<size_t>(numNodes), 0);
+  m_nodeLoc.assign(static_cast<size_t>(numNodes), 0);
+  for (int n = 0; n < numNodes; ++n) {
+    const int k = m_nodeItem[n];
+    const int loc = m_setStart[k] + m_setSize[k]++;
+    m_set[loc] = n;
+    m_nodeLoc[n] = loc;
+  }
+
+  m_optionalPieces = optionalPieces;
+  m_secondary.assign(static_cast<size_t>(numItems), 0);
+  if (optionalPieces) {
+    std::fill(m_secondary.begin() + pieceItemsStart, m_secondary.end(), 1);
+  }
+
+  m_items.resize(static_cast<size_t>(numItems));
+  m_itemPos.resize(static_cast<size_t>(numItems));
+  for (int k = 0; k < numItems; ++k) {
+    m_items[k] = k;
+    m_itemPos[k] = k;
+  }
+  m_activeItems = numItems;
+
+  m_trail.clear();
+  m_trail.reserve(static_cast<size_t>(numNodes));
+
+  m_numCellItems = pieceItemsStart;
+  m_pieceArea.assign(static_cast<size_t>(numPieces), 0);
+  for (const Placement& pl : placements) {
+    m_pieceArea[static_cast<size_t>(pl.pieceID)] = static_cast<int>(pl.cells.size());
+  }
+
+  // Usable orthogonal neighbors of every cell, -1 padded
+  m_neighbors.assign(4 * static_cast<size_t>(m_numCellItems), -1);
+  for (int y = 0; y < boardHeight; ++y) {
+    for (int x = 0; x < boardWidth; ++x) {
+      const int item = boardCellToItem[y * boardWidth + x];
+      if (item < 0) continue;
+      const int candidates[4] = {
+        x > 0 ? boardCellToItem[y * boardWidth + x - 1] : -1,
+        x + 1 < boardWidth ? boardCellToItem[y * boardWidth + x + 1] : -1,
+        y > 0 ? boardCellToItem[(y - 1) * boardWidth + x] : -1,
+        y + 1 < boardHeight ? boardCellToItem[(y + 1) * boardWidth + x] : -1
+      };
+      int k = 0;
+      for (int n : candidates) {
+        if (n >= 0) m_neighbors[4 * static_cast<size_t>(item) + k++] = n;
+      }
+    }
+  }
+
+  m_visited.assign(static_cast<size_t>(m_numCellItems), 0);
+  m_visitStamp = 0;
+  m_fillStack.reserve(static_cast<size_t>(m_numCellItems));
+}
+
+void DancingCells::setHeuristic(HeuristicMode heuristic)
+{
+  m_heuristic = heuristic;
+}
+
+void DancingCells::setIdenticalPieces(const std::vector<Placement>& placements,
+                                      const std::vector<int>& previousCopy)
+{
+  m_copyOrder.setup(placements, previousCopy);
+}
+
+void DancingCells::search()
+{
+  m_rows.clear();
+  searchFrom<false>();
+}
+
+uint64_t DancingCells::countSolutions()
+{
+  m_count = 0;
+  searchFrom<true>();
+  if (p_solutionsFound) p_solutionsFound->fetch_add(m_count);
+  return m_count;
+}
+
+uint64_t DancingCells::countSolutionsPerBranch(const std::function<void(int, uint64_t)>& onBranch)
+{
+  const int item = chooseItem();
+  if (item < 0) return countSolutions();
+
+  if (p_nodesVisited) p_nodesVisited->fetch_add(1);
+  uint64_t total = 0;
+  const int activeItems = m_activeItems;
+  const size_t trailSize = m_trail.size();
+  const int start = m_setStart[item];
+  const int size = m_setSize[item];
+  for (int e = start; e < start + size; ++e) {
+    const int option = m_nodeOption[m_set[e]];
+    const int rowID = m_optionRowID[option];
+    if (m_copyOrder.active() && !m_copyOrder.allows(rowID)) continue;
+    if (m_copyOrder.active()) m_copyOrder.place(rowID);
+    selectOption(option);
+    m_count = 0;
+    searchFrom<true>(option);
+    restore(activeItems, trailSize);
+    if (m_copyOrder.active()) m_copyOrder.unplace(rowID);
+
+    if (p_solutionsFound) p_solutionsFound->fetch_add(m_count);
+    total += m_count;
+    if (onBranch) onBranch(m_optionRowID[option], m_count);
+  }
+  return total;
+}
+
+int DancingCells::chooseItem() const
+{
+  int best = -1;
+  int bestSize = std::numeric_limits<int>::max();
+  for (int p = 0; p < m_activeItems; ++p) {
+    const int k = m_items[p];
+    if (m_setSize[k] < bestSize && !m_secondary[k]) {
+      bestSize = m_setSize[k];
+      best = k;
+      if (bestSize <= 1) break;
+    }
+  }
+  return best;
+}
+
+void DancingCells::deactivate(int item)
+{
+  const int p = m_itemPos[item];
+  const int last = m_items[m_activeItems - 1];
+  m_items[p] = last;
+  m_itemPos[last] = p;
+  m_items[m_activeItems - 1] = item;
+  m_itemPos[item] = m_activeItems - 1;
+  --m_activeItems;
+}
+
+void DancingCells::hideOption(int option)
+{
+  const int* const nodeItem = m_nodeItem.data();
+  const int* const itemPos = m_itemPos.data();
+  const int* const setStart = m_setStart.data();
+  int* const setSize = m_setSize.data();
+  int* const nodeLoc = m_nodeLoc.data();
+  int* const set = m_set.data();
+
+  for (int n = m_optionStart[option]; n < m_optionStart[option + 1]; ++n) {
+    const int k = nodeItem[n];
+    if (itemPos[k] >= m_activeItems) continue;
+
+    const int loc = nodeLoc[n];
+    const int lastLoc = setStart[k] + setSize[k] - 1;
+    const int lastNode = set[lastLoc];
+    set[loc] = lastNode;
+    nodeLoc[lastNode] = loc;
+    set[lastLoc] = n;
+    nodeLoc[n] = lastLoc;
+    --setSize[k];
+    m_trail.push_back(k);
+  }
+}
+
+void DancingCells::selectOption(int option)
+{
+  const int begin = m_optionStart[option];
+  const int end = m_optionStart[option + 1];
+
+  for (int n = begin; n < end; ++n) {
+    deactivate(m_nodeItem[n]);
+  }
+
+  // Every other option sharing an item with this one is no longer possible.
+  // Options sharing several items are listed in several sets; hide them once.
+  if (++m_stamp == 0) {
+    std::fill(m_optionStamp.begin(), m_optionStamp.end(), 0);
+    m_stamp = 1;
+  }
+  m_optionStamp[option] = m_stamp;
+
+  for (int n = begin; n < end; ++n) {
+    const int k = m_nodeItem[n];
+    const int setBegin = m_setStart[k];
+    const int setEnd = setBegin + m_setSize[k];
+    for (int e = setBegin; e < setEnd; ++e) {
+      const int other = m_nodeOption[m_set[e]];
+      if (m_optionStamp[other] == m_stamp) continue;
+      m_optionStamp[other] = m_stamp;
+      hideOption(other);
+    }
+  }
+}
+
+void DancingCells::restore(int activeItems, size_t trailSize)
+{
+  while (m_trail.size() > trailSize) {
+    ++m_setSize[m_trail.back()];
+    m_trail.pop_back();
+  }
+  m_activeItems = activeItems;
+}
+
+bool DancingCells::hasDeadRegion(int option, const RegionBound& parent, RegionBound& bound)
+{
+  bound = RegionBound{};
+  if (m_numCellItems == 0) return false;
+
+  int minArea = std::numeric_limits<int>::max();
+  int areaGcd = 0;
+  int remainingArea = 0;
+  int freeArea = m_numCellItems;
+  for (size_t p = 0; p < m_pieceArea.size(); ++p) {
+    const int area = m_pieceArea[p];
+    if (!isActive(m_numCellItems + static_cast<int>(p))) {
+      freeArea -= area;
+    }
+    else if (area > 0) {
+      remainingArea += area;
+      minArea = std::min(minArea, area);
+      if (area != areaGcd) areaGcd = std::gcd(areaGcd, area);
+    }
+  }
+  if (areaGcd == 0) return false;
+  bound = RegionBound{minArea, areaGcd};
+
+  // See DLX::hasDeadRegion: with an exact fill, a bad region has a partner
+  // no larger than half the free area
+  const int fillLimit = (!m_optionalPieces && remainingArea == freeArea) ? freeArea / 2 : freeArea;
+
+  if (m_visitStamp > std::numeric_limits<uint32_t>::max() - m_visited.size() - 1) {
+    std::fill(m_visited.begin(), m_visited.end(), 0);
+    m_visitStamp = 0;
+  }
+  const uint32_t base = m_visitStamp + 1;
+
+  auto regionIsDead = [&](int start) {
+    const uint32_t stamp = ++m_visitStamp;
+    int area = 0;
+    m_fillStack.clear();
+    m_fillStack.push_back(start);
+    m_visited[static_cast<size_t>(start)] = stamp;
+    while (!m_fillStack.empty()) {
+      const int cell = m_fillStack.back();
+      m_fillStack.pop_back();
+      ++area;
+      for (int k = 0; k < 4; ++k) {
+        const int n = m_neighbors[4 * static_cast<size_t>(cell) + k];
+        if (n < 0 || !isActive(n)) continue;
+        uint32_t& mark = m_visited[static_cast<size_t>(n)];
+        if (mark == stamp) continue;
+        if (mark >= base) return false;
+        mark = stamp;
+        m_fillStack.push_back(n);
+      }
+      if (area > fillLimit) return false;
+    }
+    return area < minArea || area % areaGcd != 0;
+  };
+
+  auto unvisited = [&](int cell) {
+    return cell >= 0 && isActive(cell) && m_visited[static_cast<size_t>(cell)] < base;
+  };
+
+  if (option < 0 || !(bound == parent)) {
+    for (int cell = 0; cell < m_numCellItems; ++cell) {
+      if (unvisited(cell) && regionIsDead(cell)) return true;
+    }
+    return false;
+  }
+
+  for (int n = m_optionStart[option]; n < m_optionStart[option + 1]; ++n) {
+    const int cell = m_nodeItem[n];
+    if (cell >= m_numCellItems) continue;
+    for (int k = 0; k < 4; ++k) {
+      const int next = m_neighbors[4 * static_cast<size_t>(cell) + k];
+      if (unvisited(next) && regionIsDead(next)) return true;
+    }
+  }
+  return false;
+}
+
+template <bool CountOnly>
+void DancingCells::searchFrom(int lastOption, const RegionBound& parent)
+{
+  if (p_stopFlag && p_stopFlag->load(std::memory_order_relaxed)) return;
+
+  const int item = chooseItem();
+  if (item < 0) {
+    if (m_optionalPieces && m_copyOrder.active() && !m_copyOrder.usesFirstCopies()) return;
+    if constexpr (CountOnly) {
+      ++m_count;
+    }
+    else {
+      if (handleSolution) handleSolution(m_rows);
+      if (p_solutionsFound) p_solutionsFound->fetch_add(1);
+    }
+    return;
+  }
+  if (p_nodesVisited) p_nodesVisited->fetch_add(1);
+
+  RegionBound bound;
+  if (m_heuristic == HeuristicMode::LeastFilled && hasDeadRegion(lastOption, parent, bound)) return;
+
+  const int size = m_setSize[item];
+  if (size == 0) return;
+
+  // The chosen item is deactivated by every option tried here, so its set
+  // keeps the same order and length across the loop
+  const int activeItems = m_activeItems;
+  const size_t trailSize = m_trail.size();
+  const int start = m_setStart[item];
+  for (int e = start; e < start + size; ++e) {
+    const int option = m_nodeOption[m_set[e]];
+    const int rowID = m_optionRowID[option];
+    if (m_copyOrder.active()) {
+      if (!m_copyOrder.allows(rowID)) continue;
+      m_copyOrder.place(rowID);
+    }
+    if constexpr (!CountOnly) m_rows.push_back(rowID);
+    selectOption(option);
+    searchFrom<CountOnly>(option, bound);
+    restore(activeItems, trailSize);
+    if constexpr (!CountOnly) m_rows.pop_back();
+    if (m_copyOrder.active()) m_copyOrder.unplace(rowID);
+  }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "copy_order.h"
+#include "dlx.h"
+#include "shapes.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Exact-cover search on sparse sets ("dancing cells").
+// Active items live in a dense array with a position map. Each item has a
+// dense segment listing the options that contain it, of which the first
+// setSize[item] are still active. Removing an option from an item swaps it
+// behind the active prefix, so backtracking only restores array lengths
+// (from a trail) instead of relinking nodes.
+class DancingCells
+{
+public:
+  // external control/monitoring hooks
+  std::function<void(const std::vector<int>&)> handleSolution;
+  std::atomic<uint64_t>* p_nodesVisited = nullptr;
+  std::atomic<uint64_t>* p_solutionsFound = nullptr;
+  std::atomic<bool>* p_stopFlag = nullptr;
+
+  // Items are board cells + one item per piece, options are placements.
+  // With optionalPieces the piece items are secondary (used at most once).
+  void setup(const std::vector<Placement>& placements,
+             const std::vector<bool>& boardMask,
+             int boardWidth, int boardHeight, int numPieces,
+             bool optionalPieces = false);
+
+  // Both modes branch on the item with the fewest active options, as DLX does;
+  // LeastFilled also prunes dead regions of free cells like DLX
+  void setHeuristic(HeuristicMode);
+
+  // Search identical pieces in one order only (see CopyOrder)
+  void setIdenticalPieces(const std::vector<Placement>& placements, const std::vector<int>& previousCopy);
+
+  void search();
+  uint64_t countSolutions();
+  uint64_t countSolutionsPerBranch(const std::function<void(int, uint64_t)>& onBranch);
+
+private:
+  HeuristicMode m_heuristic = HeuristicMode::None;
+
+  // Options: items of option o are m_nodeItem[m_optionStart[o] .. m_optionStart[o + 1])
+  std::vector<int> m_optionStart;
+  std::vector<int> m_optionRowID;
+  std::vector<int> m_nodeItem;
+  std::vector<int> m_nodeOption;
+  std::vector<int> m_nodeLoc; // position of each node in m_set
+
+  // Options already hidden by the current selectOption() call carry its stamp
+  std::vector<uint32_t> m_optionStamp;
+  uint32_t m_stamp = 0;
+
+  // Per item: nodes of the options containing it, m_set[m_setStart[i] ..]
+  std::vector<int> m_setStart;
+  std::vector<int> m_setSize;
+  std::vector<int> m_set;
+
+  // Secondary items are never branched on and need not be covered
+  std::vector<uint8_t> m_secondary;
+
+  // Sparse set of active items
+  std::vector<int> m_items;
+  std::vector<int> m_itemPos;
+  int m_activeItems = 0;
+
+  // Items whose set size was decremented, for undo
+  std::vector<int> m_trail;
+
+  std::vector<int> m_rows;
+  uint64_t m_count = 0;
+
+  CopyOrder m_copyOrder;
+  bool m_optionalPieces = false;
+
+  // Board cells are items 0 .. m_numCellItems - 1, piece items follow
+  int m_numCellItems = 0;
+  std::vector<int> m_neighbors;     // 4 cell items per cell item, -1 padded
+  std::vector<int> m_pieceArea;     // by piece
+  std::vector<uint32_t> m_visited;  // flood fill stamps
+  uint32_t m_visitStamp = 0;
+  std::vector<int> m_fillStack;
+
+  bool isActive(int item) const { return m_itemPos[item] < m_activeItems; }
+  // Active primary item with the fewest options (-1 if none is left)
+  int chooseItem() const;
+
+  void deactivate(int item);
+  void hideOption(int option);
+  void selectOption(int option);
+
+  // Undo back to a saved (active item count, trail length)
+  void restore(int activeItems, size_t trailSize);
+
+  // As DLX::hasDeadRegion, with the cells of 'option' (-1: the whole board)
+  // as the ones just covered. Used pieces are known here even when optional.
+  bool hasDeadRegion(int option, const RegionBound& parent, RegionBound& bound);
+
+  // 'lastOption' was selected by the parent, which passed its dead-region
+  // check with 'parent'
+  template <bool CountOnly>
+  void searchFrom(int lastOption = -1, const RegionBound& parent = RegionBound{});
+};
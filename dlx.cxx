@@ -1,36 +1,151 @@
 #include "dlx.h"
 
+#include "bounded_draw.h"
+
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define DLX_VECTOR_ARGMIN 1
+#endif
+
+#if defined(DLX_VECTOR_ARGMIN)
+namespace
+{
+// Index of the first minimum of max(size[i], 1), i.e. the first size <= 1 if
+// there is one, else the first minimum: the same choice as a ring scan that
+// stops at the first column with at most one row. The kernels are compiled
+// for their instruction set regardless of the build flags and picked by
+// pickArgmin() from what the running CPU supports.
+inline size_t argminTail(const int* size, size_t n, size_t i, size_t best, int bestSize)
+{
+  for (; i < n; ++i) {
+    const int s = std::max(size[i], 1);
+    if (s < bestSize) {
+      bestSize = s;
+      best = i;
+      if (bestSize <= 1) break;
+    }
+  }
+  return best;
+}
+
+__attribute__((target("avx2")))
+size_t argminSizeAVX2(const int* size, size_t n)
+{
+  size_t best = 0;
+  int bestSize = std::numeric_limits<int>::max();
+  size_t i = 0;
+
+  const __m256i one = _mm256_set1_epi32(1);
+  for (; i + 8 <= n; i += 8) {
+    const __m256i v = _mm256_max_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(size + i)), one);
+    __m128i m = _mm_min_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+    const int blockMin = _mm_cvtsi128_si32(m);
+    if (blockMin < bestSize) {
+      const int lanes = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, _mm256_set1_epi32(blockMin))));
+      bestSize = blockMin;
+      best = i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(lanes)));
+      if (bestSize <= 1) return best;
+    }
+  }
+  return argminTail(size, n, i, best, bestSize);
+}
+
+__attribute__((target("sse4.1")))
+size_t argminSizeSSE41(const int* size, size_t n)
+{
+  size_t best = 0;
+  int bestSize = std::numeric_limits<int>::max();
+  size_t i = 0;
+
+  const __m128i one = _mm_set1_epi32(1);
+  for (; i + 4 <= n; i += 4) {
+    const __m128i v = _mm_max_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(size + i)), one);
+    __m128i m = _mm_min_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+    const int blockMin = _mm_cvtsi128_si32(m);
+    if (blockMin < bestSize) {
+      const int lanes = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, _mm_set1_epi32(blockMin))));
+      bestSize = blockMin;
+      best = i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(lanes)));
+      if (bestSize <= 1) return best;
+    }
+  }
+  return argminTail(size, n, i, best, bestSize);
+}
+
+using ArgminKernel = size_t (*)(const int*, size_t);
+
+ArgminKernel pickArgmin()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return argminSizeAVX2;
+  if (__builtin_cpu_supports("sse4.1")) return argminSizeSSE41;
+  return nullptr;
+}
+}
+#endif
 
 DLX::DLX()
 {
-  m_header = makeColumn("header");
-  m_header->L = m_header->R = m_header;
+  makeNode(kRoot, -1);
+  m_size[kRoot] = kInactive;
 }
 
 void DLX::setup(const std::vector<Placement>& placements,
                 const std::vector<bool>& boardMask,
                 int boardWidth, int boardHeight,
-                int numPieces)
+                int numPieces, bool optionalPieces)
 {
+#if defined(DLX_VECTOR_ARGMIN)
+  static const ArgminKernel argmin = pickArgmin();
+  m_argmin = argmin;
+#endif
+
   std::vector<int> boardCellToColumn(boardWidth * boardHeight, -1);
   int colIndex = 0;
 
   for (int i = 0; i < boardWidth * boardHeight; ++i) {
     if (boardMask[i]) {
       boardCellToColumn[i] = colIndex++;
+    }
+  }
+
+  // Size the arrays once so the whole matrix is contiguous
+  size_t numRowNodes = 0;
+  for (const Placement& pl : placements) {
+    numRowNodes += pl.cells.size() + 1;
+  }
+
+  const size_t totalNodes = 1 + static_cast<size_t>(colIndex + numPieces) + numRowNodes;
+  for (auto* links : {&m_L, &m_R, &m_U, &m_D, &m_col}) {
+    links->reserve(totalNodes);
+  }
+  m_rowID.reserve(totalNodes);
+  m_size.reserve(1 + static_cast<size_t>(colIndex + numPieces));
+
+  for (int i = 0; i < boardWidth * boardHeight; ++i) {
+    if (boardMask[i]) {
       addColumn("C" + std::to_string(i));
     }
   }
 
   int pieceColsStart = colIndex;
   for (int p = 0; p < numPieces; ++p) {
-    addColumn("P" + std::to_string(p));
+    addColumn("P" + std::to_string(p), !optionalPieces);
   }
 
+  std::vector<int> rowCols;
   for (size_t i = 0; i < placements.size(); ++i) {
     const Placement& pl = placements[i];
-    std::vector<int> rowCols;
+    rowCols.clear();
 
     bool placementValid = true;
     for (int cell : pl.cells) {
@@ -47,6 +162,54 @@ void DLX::setup(const std::vector<Placement>& placements,
     rowCols.push_back(pieceColsStart + pl.pieceID);
     addRow(static_cast<int>(i), rowCols);
   }
+
+  m_numCellColumns = colIndex;
+  m_cellColumn.assign(boardCellToColumn.size(), kRoot);
+  m_columnCell.assign(m_size.size(), -1);
+  for (size_t i = 0; i < boardCellToColumn.size(); ++i) {
+    if (boardCellToColumn[i] < 0) continue;
+    const Link c = static_cast<Link>(boardCellToColumn[i]) + 1;
+    m_cellColumn[i] = c;
+    m_columnCell[c] = static_cast<int>(i);
+  }
+
+  m_optionalPieces = optionalPieces;
+  m_pieceColumns.resize(static_cast<size_t>(numPieces));
+  m_pieceArea.assign(static_cast<size_t>(numPieces), 0);
+  for (int p = 0; p < numPieces; ++p) {
+    m_pieceColumns[p] = static_cast<Link>(pieceColsStart + p) + 1;
+  }
+  for (const Placement& pl : placements) {
+    m_pieceArea[static_cast<size_t>(pl.pieceID)] = static_cast<int>(pl.cells.size());
+  }
+
+  // Usable orthogonal neighbors of every cell, -1 padded
+  m_neighbors.assign(4 * m_cellColumn.size(), -1);
+  for (int y = 0; y < boardHeight; ++y) {
+    for (int x = 0; x < boardWidth; ++x) {
+      const int cell = y * boardWidth + x;
+      const int candidates[4] = {
+        x > 0 ? cell - 1 : -1, x + 1 < boardWidth ? cell + 1 : -1,
+        y > 0 ? cell - boardWidth : -1, y + 1 < boardHeight ? cell + boardWidth : -1
+      };
+      int k = 0;
+      for (int n : candidates) {
+        if (n >= 0 && m_cellColumn[static_cast<size_t>(n)] != kRoot) {
+          m_neighbors[4 * static_cast<size_t>(cell) + k++] = n;
+        }
+      }
+    }
+  }
+
+  m_visited.assign(m_cellColumn.size(), 0);
+  m_visitStamp = 0;
+  m_fillStack.reserve(m_cellColumn.size());
+}
+
+void DLX::setIdenticalPieces(const std::vector<Placement>& placements, const std::vector<int>& previousCopy)
+{
+  m_copyOrder.setup(placements, previousCopy);
+  m_optionalCopies = m_copyOrder.active() && m_optionalPieces;
 }
 
 void DLX::setHeuristic(HeuristicMode heuristic)
@@ -54,84 +217,226 @@ void DLX::setHeuristic(HeuristicMode heuristic)
   m_heuristic = heuristic;
 }
 
-int DLX::addColumn(const std::string& name) {
-  ColumnNode* c = makeColumn(name);
-  c->R = m_header;
-  c->L = m_header->L;
-  m_header->L->R = c;
-  m_header->L = c;
-  c->U = c->D = c;
-  m_columns.push_back(c);
-  return static_cast<int>(m_columns.size() - 1);
+int DLX::addColumn(const std::string& name, bool primary) {
+  if (m_size.size() != m_col.size()) {
+    throw std::logic_error("DLX columns must be added before rows");
+  }
+  const Link c = makeNode(kRoot, -1);
+  m_col[c] = c;
+  if (primary) {
+    m_R[c] = kRoot;
+    m_L[c] = m_L[kRoot];
+    m_R[m_L[kRoot]] = c;
+    m_L[kRoot] = c;
+  }
+  else {
+    // Self-linked, so cover/uncover leave the header ring alone
+    m_R[c] = c;
+    m_L[c] = c;
+    m_size[c] = kInactive;
+  }
+  m_columnNames.push_back(name);
+  return static_cast<int>(m_columnNames.size() - 1);
 }
 
 void DLX::addRow(int rowID, const std::vector<int>& cols) {
-  std::vector<DLXNode*> rowNodes;
-  for (int col : cols) {
-    ColumnNode* C = m_columns[static_cast<size_t>(col)];
-    DLXNode* node = makeNode();
-    node->rowID = rowID;
-    node->colID = col;
+  if (cols.empty()) return;
 
-    // Vertical insert
-    node->D = C;
-    node->U = C->U;
-    C->U->D = node;
-    C->U = node;
-    C->size++;
+  const Link first = static_cast<Link>(m_col.size());
+  const Link n = static_cast<Link>(cols.size());
 
-    rowNodes.push_back(node);
+  if (rowID >= static_cast<int>(m_rowNode.size())) {
+    m_rowNode.resize(static_cast<size_t>(rowID) + 1, kRoot);
   }
+  m_rowNode[static_cast<size_t>(rowID)] = first;
 
-  // Horizontal circular linking
-  size_t n = rowNodes.size();
-  for (size_t i = 0; i < n; ++i) {
-    rowNodes[i]->R = rowNodes[(i + 1) % n];
-    rowNodes[i]->L = rowNodes[(i + n - 1) % n];
+  for (Link i = 0; i < n; ++i) {
+    const Link C = static_cast<Link>(cols[i]) + 1;
+    const Link node = makeNode(C, rowID);
+
+    // Vertical insert
+    m_D[node] = C;
+    m_U[node] = m_U[C];
+    m_D[m_U[C]] = node;
+    m_U[C] = node;
+    m_size[C]++;
+
+    // Horizontal circular linking (row nodes are consecutive)
+    m_R[node] = first + (i + 1) % n;
+    m_L[node] = first + (i + n - 1) % n;
   }
 }
 
-void DLX::cover(ColumnNode* c) {
-  c->R->L = c->L;
-  c->L->R = c->R;
-  for (DLXNode* i = c->D; i != c; i = i->D)
-    for (DLXNode* j = i->R; j != i; j = j->R) {
-      j->D->U = j->U;
-      j->U->D = j->D;
-      static_cast<ColumnNode*>(m_columns[j->colID])->size--;
+DLX::Link DLX::chooseColumnNone() const {
+  if (m_argmin) {
+    // Ring order is header order, so the first minimum in the array is the
+    // column the ring scan would pick. Only the root is left when every
+    // primary column is covered.
+    const Link best = static_cast<Link>(m_argmin(m_size.data(), m_size.size()));
+    return (m_size[best] >= kInactive) ? kRoot : best;
+  }
+  // Without vector instructions, walking only the active columns is faster
+  Link best = kRoot;
+  int bestSize = std::numeric_limits<int>::max();
+  for (Link c = m_R[kRoot]; c != kRoot; c = m_R[c])
+    if (m_size[c] < bestSize) {
+      bestSize = m_size[c];
+      best = c;
+      if (bestSize <= 1) break;
     }
+  return best;
 }
 
-void DLX::uncover(ColumnNode* c) {
-  for (DLXNode* i = c->U; i != c; i = i->U)
-    for (DLXNode* j = i->L; j != i; j = j->L) {
-      static_cast<ColumnNode*>(m_columns[j->colID])->size++;
-      j->D->U = j;
-      j->U->D = j;
+DLX::Link DLX::chooseColumnLeastFilled() const
+{
+  return chooseColumnNone();
+}
+
+bool DLX::hasDeadRegion(Link row, const RegionBound& parent, RegionBound& bound)
+{
+  bound = RegionBound{};
+  if (m_cellColumn.empty()) return false;
+
+  int minArea = std::numeric_limits<int>::max();
+  int areaGcd = 0;
+  int remainingArea = 0;
+  int freeArea = m_numCellColumns - m_removedCells;
+  // Secondary piece columns do not show whether they are covered, so with
+  // optional pieces every piece counts as remaining (a weaker, still valid
+  // bound) and no region is skipped for size
+  for (size_t p = 0; p < m_pieceColumns.size(); ++p) {
+    const int area = m_pieceArea[p];
+    if (!m_optionalPieces && isCovered(m_pieceColumns[p])) {
+      freeArea -= area;
+    }
+    else if (area > 0) {
+      remainingArea += area;
+      minArea = std::min(minArea, area);
+      if (area != areaGcd) areaGcd = std::gcd(areaGcd, area);
+    }
+  }
+  if (areaGcd == 0) return false;
+  bound = RegionBound{minArea, areaGcd};
+
+  // When the remaining pieces exactly fill the free cells, a bad region
+  // always comes with a second one (the areas still add up), so one of them
+  // is at most half the free area and larger regions need not be measured
+  const int fillLimit = (!m_optionalPieces && remainingArea == freeArea) ? freeArea / 2 : freeArea;
+
+  // Every flood fill gets its own stamp; stamps from 'base' on belong to
+  // this check
+  if (m_visitStamp > std::numeric_limits<uint32_t>::max() - m_visited.size() - 1) {
+    std::fill(m_visited.begin(), m_visited.end(), 0);
+    m_visitStamp = 0;
+  }
+  const uint32_t base = m_visitStamp + 1;
+
+  auto isFree = [&](int cell) { return !isCovered(m_cellColumn[static_cast<size_t>(cell)]); };
+
+  // Flood fill the region containing 'start' and test its area. A fill that
+  // exceeds fillLimit is abandoned; a later fill that runs into its cells is
+  // in the same region and is abandoned too.
+  auto regionIsDead = [&](int start) {
+    const uint32_t stamp = ++m_visitStamp;
+    int area = 0;
+    m_fillStack.clear();
+    m_fillStack.push_back(start);
+    m_visited[static_cast<size_t>(start)] = stamp;
+    while (!m_fillStack.empty()) {
+      const int cell = m_fillStack.back();
+      m_fillStack.pop_back();
+      ++area;
+      for (int k = 0; k < 4; ++k) {
+        const int n = m_neighbors[4 * static_cast<size_t>(cell) + k];
+        if (n < 0 || !isFree(n)) continue;
+        uint32_t& mark = m_visited[static_cast<size_t>(n)];
+        if (mark == stamp) continue;
+        if (mark >= base) return false;
+        mark = stamp;
+        m_fillStack.push_back(n);
+      }
+      if (area > fillLimit) return false;
+    }
+    return area < minArea || area % areaGcd != 0;
+  };
+
+  auto unvisited = [&](int cell) {
+    return cell >= 0 && isFree(cell) && m_visited[static_cast<size_t>(cell)] < base;
+  };
+
+  // Placing a row can shrink regions away from it too: the remaining
+  // pieces' minimum area or gcd may have changed
+  if (row == kRoot || !(bound == parent)) {
+    for (int cell = 0; cell < static_cast<int>(m_cellColumn.size()); ++cell) {
+      if (m_cellColumn[static_cast<size_t>(cell)] != kRoot && unvisited(cell) && regionIsDead(cell)) return true;
     }
-  c->R->L = c;
-  c->L->R = c;
+    return false;
+  }
+
+  Link j = row;
+  do {
+    const int cell = m_columnCell[m_col[j]];
+    if (cell >= 0) {
+      for (int k = 0; k < 4; ++k) {
+        const int n = m_neighbors[4 * static_cast<size_t>(cell) + k];
+        if (unvisited(n) && regionIsDead(n)) return true;
+      }
+    }
+    j = m_R[j];
+  } while (j != row);
+  return false;
 }
 
-ColumnNode* DLX::chooseColumnNone() const {
-  ColumnNode* best = nullptr;
+DLX::Link DLX::chooseColumnRandomTie() const
+{
+  Link best = kRoot;
   int bestSize = std::numeric_limits<int>::max();
-  for (ColumnNode* c = static_cast<ColumnNode*>(m_header->R); c != m_header; c = static_cast<ColumnNode*>(c->R))
-    if (c->size < bestSize) {
-      bestSize = c->size;
+  uint64_t ties = 0;
+  for (Link c = m_R[kRoot]; c != kRoot; c = m_R[c]) {
+    if (m_size[c] < bestSize) {
+      bestSize = m_size[c];
+      best = c;
+      ties = 1;
+      if (bestSize == 0) break;
+    }
+    else if (m_size[c] == bestSize && m_tieRng() % ++ties == 0) {
+      // Reservoir sampling keeps each tied column with equal probability
       best = c;
-      if (bestSize <= 1) break;
     }
+  }
   return best;
 }
 
-ColumnNode* DLX::chooseColumnLeastFilled() const
+void DLX::setRandomTieBreak(uint64_t seed)
 {
-  return chooseColumnNone();
+  m_randomTies = seed != 0;
+  m_tieRng.seed(seed);
 }
 
-ColumnNode* DLX::chooseColumn() const
+void DLX::shuffleRows(std::mt19937_64& rng)
 {
+  std::vector<Link> rows;
+  for (Link c = 1; c < static_cast<Link>(m_size.size()); ++c) {
+    rows.clear();
+    for (Link r = m_D[c]; r != c; r = m_D[r]) rows.push_back(r);
+    std::shuffle(rows.begin(), rows.end(), rng);
+
+    Link prev = c;
+    for (Link r : rows) {
+      m_D[prev] = r;
+      m_U[r] = prev;
+      prev = r;
+    }
+    m_D[prev] = c;
+    m_U[c] = prev;
+  }
+}
+
+DLX::Link DLX::chooseColumn() const
+{
+  if (m_randomTies) {
+    return chooseColumnRandomTie();
+  }
   if (m_heuristic == HeuristicMode::None) {
     return chooseColumnNone();
   }
@@ -140,66 +445,289 @@ ColumnNode* DLX::chooseColumn() const
   }
 }
 
-void DLX::search(int k) {
-  if (p_stopFlag && p_stopFlag->load()) return;
-  if (m_header->R == m_header) {
-    if (handleSolution) handleSolution(m_solutionRows);
-    if (p_solutionsFound) p_solutionsFound->fetch_add(1);
-    return;
+void DLX::search() {
+  beginSearch();
+  resume();
+}
+
+void DLX::beginSearch() {
+  // Every level covers at least one primary column, so this bounds the depth
+  m_stack.assign(numColumns() + 1, Frame{kRoot, kRoot, kRoot});
+  m_regionBound.assign(m_stack.size(), RegionBound{});
+  m_baseDepth = m_solutionRows.size();
+  m_solutionRows.reserve(m_baseDepth + m_stack.size());
+  m_level = 0;
+  m_phase = SearchPhase::Enter;
+  m_solutionCount = 0;
+}
+
+bool DLX::step(uint64_t maxNodes) {
+  CallbackVisitor visitor{*this};
+  return step(visitor, maxNodes);
+}
+
+bool DLX::countStep(uint64_t maxNodes) {
+  CountVisitor visitor{m_solutionCount, p_stopFlag};
+  const uint64_t before = m_solutionCount;
+  const bool more = step(visitor, maxNodes);
+  if (p_solutionsFound) p_solutionsFound->fetch_add(m_solutionCount - before);
+  return more;
+}
+
+void DLX::flushCounters() {
+  if (p_nodesVisited && m_pendingNodes) p_nodesVisited->fetch_add(m_pendingNodes);
+  m_pendingNodes = 0;
+  m_counters.flushTo(p_searchStats);
+}
+
+uint64_t DLX::countSolutions() {
+  // Count in slices so p_solutionsFound stays current for progress reports
+  constexpr uint64_t kSliceNodes = 1 << 16;
+  beginSearch();
+  while (countStep(kSliceNodes)) {
+  }
+  return m_solutionCount;
+}
+
+uint64_t DLX::countSolutionsPerBranch(const std::function<void(int, uint64_t)>& onBranch) {
+  if (isSolved() || (p_stopFlag && p_stopFlag->load())) {
+    return countSolutions();
   }
+
   if (p_nodesVisited) p_nodesVisited->fetch_add(1);
+  const std::vector<int> rows = branchRows();
+  m_counters.node(static_cast<int>(m_solutionRows.size()));
+  m_counters.branch(static_cast<int>(m_solutionRows.size()), static_cast<int>(rows.size()));
+  flushCounters();
+
+  uint64_t total = 0;
+  for (int row : rows) {
+    selectRow(row);
+    const uint64_t count = countSolutions();
+    unselectRow(row);
+    total += count;
+    if (onBranch) onBranch(row, count);
+  }
+  return total;
+}
+
+void DLX::resume() {
+  while (step(std::numeric_limits<uint64_t>::max())) {
+  }
+}
 
-  ColumnNode* c = chooseColumn();
-  if (!c || c->size == 0) return;
+void DLX::abandonSearch() {
+  if (m_phase == SearchPhase::Done) return;
 
-  cover(c);
-  for (DLXNode* r = c->D; r != c; r = r->D) {
-    m_solutionRows.push_back(r->rowID);
-    for (DLXNode* j = r->R; j != r; j = j->R) cover(m_columns[j->colID]);
-    search(k + 1);
-    for (DLXNode* j = r->L; j != r; j = j->L) uncover(m_columns[j->colID]);
+  // Frames below m_level have a row applied; the frame at m_level has only
+  // its column covered while rows are being tried.
+  if (m_phase == SearchPhase::TryRow) {
+    uncover(m_stack[m_level].column);
+  }
+  while (m_level > 0) {
+    const Frame& f = m_stack[--m_level];
+    for (Link j = m_L[f.row]; j != f.row; j = m_L[j]) uncover(m_col[j]);
     m_solutionRows.pop_back();
+    if (m_copyOrder.active()) m_copyOrder.unplace(m_rowID[f.row]);
+    uncover(f.column);
   }
-  uncover(c);
+  m_phase = SearchPhase::Done;
+}
+
+std::vector<int> DLX::searchPath() const {
+  const auto begin = m_solutionRows.begin() + static_cast<std::ptrdiff_t>(m_baseDepth);
+  return std::vector<int>(begin, m_solutionRows.end());
+}
+
+void DLX::replayPath(const std::vector<int>& rows) {
+  for (int rowID : rows) {
+    const Link c = chooseColumn();
+    if (c == kRoot) {
+      abandonSearch();
+      throw std::runtime_error("Search path is deeper than the search tree");
+    }
+
+    Link r = m_D[c];
+    while (r != c && m_rowID[r] != rowID) r = m_D[r];
+    if (r == c) {
+      abandonSearch();
+      throw std::runtime_error("Row " + std::to_string(rowID) + " is not a branch of column " +
+                               m_columnNames[c - 1] + " at depth " + std::to_string(m_level));
+    }
+
+    cover(c);
+    m_stack[m_level] = Frame{c, r, kRoot};
+    m_solutionRows.push_back(rowID);
+    if (m_copyOrder.active()) m_copyOrder.place(rowID);
+    for (Link j = m_R[r]; j != r; j = m_R[j]) cover(m_col[j]);
+    // Replayed levels were never checked, so the next check scans the board
+    m_regionBound[m_level] = RegionBound{};
+    ++m_level;
+  }
+  m_phase = SearchPhase::Enter;
+}
+
+std::vector<std::vector<int>> DLX::donateWork() {
+  std::vector<std::vector<int>> prefixes;
+  if (m_phase == SearchPhase::Done) return prefixes;
+
+  for (int level = 0; level < m_level; ++level) {
+    Frame& f = m_stack[level];
+    if (f.row == f.last || m_D[f.row] == f.column) continue;
+
+    const auto pathBegin = m_solutionRows.begin();
+    const auto pathEnd = pathBegin + static_cast<std::ptrdiff_t>(m_baseDepth + level);
+    for (Link r = m_D[f.row]; r != f.column; r = m_D[r]) {
+      std::vector<int> prefix(pathBegin, pathEnd);
+      prefix.push_back(m_rowID[r]);
+      prefixes.push_back(std::move(prefix));
+    }
+    f.last = f.row;
+    break;
+  }
+  return prefixes;
+}
+
+void DLX::removeCells(const std::vector<int>& cells) {
+  for (size_t i = 0; i < cells.size(); ++i) {
+    const int cell = cells[i];
+    const Link c = (cell >= 0 && static_cast<size_t>(cell) < m_cellColumn.size())
+      ? m_cellColumn[static_cast<size_t>(cell)] : kRoot;
+    if (c == kRoot || isCovered(c)) {
+      // Leave the matrix as it was
+      restoreCells(std::vector<int>(cells.begin(), cells.begin() + static_cast<std::ptrdiff_t>(i)));
+      throw std::invalid_argument("Cell " + std::to_string(cell) + " is not a free board cell");
+    }
+    cover(c);
+    ++m_removedCells;
+  }
+}
+
+void DLX::restoreCells(const std::vector<int>& cells) {
+  for (auto it = cells.rbegin(); it != cells.rend(); ++it) {
+    uncover(m_cellColumn[static_cast<size_t>(*it)]);
+    --m_removedCells;
+  }
+}
+
+void DLX::selectRow(int rowID) {
+  const Link r = m_rowNode[static_cast<size_t>(rowID)];
+  Link j = r;
+  do {
+    cover(m_col[j]);
+    j = m_R[j];
+  } while (j != r);
+  m_solutionRows.push_back(rowID);
+  if (m_copyOrder.active()) m_copyOrder.place(rowID);
+}
+
+void DLX::unselectRow(int rowID) {
+  const Link r = m_rowNode[static_cast<size_t>(rowID)];
+  Link j = r;
+  do {
+    j = m_L[j];
+    uncover(m_col[j]);
+  } while (j != r);
+  m_solutionRows.pop_back();
+  if (m_copyOrder.active()) m_copyOrder.unplace(rowID);
+}
+
+DLX::ProbeResult DLX::probe(std::mt19937_64& rng) {
+  ProbeResult result;
+  double weight = 1.0;
+  std::vector<std::pair<Link, Link>> path; // (column, row) per level
+  Link lastRow = kRoot;
+  RegionBound parentBound, bound;
+
+  while (true) {
+    if (m_R[kRoot] == kRoot) {
+      if (!m_optionalCopies || m_copyOrder.usesFirstCopies()) result.solutions = weight;
+      break;
+    }
+    result.nodes += weight;
+
+    if (m_heuristic == HeuristicMode::LeastFilled && hasDeadRegion(lastRow, parentBound, bound)) break;
+    parentBound = bound;
+    const Link c = chooseColumn();
+    if (c == kRoot || m_size[c] == 0) break;
+
+    // The search skips rows the copy order rules out
+    int size = 0;
+    for (Link r = m_D[c]; r != c; r = m_D[r]) size += rowAllowed(m_rowID[r]) ? 1 : 0;
+    if (size == 0) break;
+
+    Link r = m_D[c];
+    while (!rowAllowed(m_rowID[r])) r = m_D[r];
+    for (uint64_t k = boundedDraw(rng, static_cast<uint64_t>(size)); k > 0; --k) {
+      do r = m_D[r]; while (!rowAllowed(m_rowID[r]));
+    }
+
+    weight *= size;
+    cover(c);
+    for (Link j = m_R[r]; j != r; j = m_R[j]) cover(m_col[j]);
+    if (m_copyOrder.active()) m_copyOrder.place(m_rowID[r]);
+    path.emplace_back(c, r);
+    lastRow = r;
+  }
+
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    const Link r = it->second;
+    if (m_copyOrder.active()) m_copyOrder.unplace(m_rowID[r]);
+    for (Link j = m_L[r]; j != r; j = m_L[j]) uncover(m_col[j]);
+    uncover(it->first);
+  }
+  return result;
+}
+
+std::vector<int> DLX::branchRows() const {
+  std::vector<int> rows;
+  const Link c = chooseColumn();
+  if (c == kRoot) return rows;
+
+  rows.reserve(static_cast<size_t>(m_size[c]));
+  for (Link r = m_D[c]; r != c; r = m_D[r]) {
+    if (rowAllowed(m_rowID[r])) rows.push_back(m_rowID[r]);
+  }
+  return rows;
 }
 
 void DLX::searchWithDebug(int depth) {
-  if (m_header->R == m_header) {
+  if (m_R[kRoot] == kRoot) {
     std::cout << "SOLUTION FOUND at depth " << depth << "\n";
     return;
   }
-  ColumnNode* c = chooseColumn();
-  if (!c || c->size == 0) {
+  const Link c = chooseColumn();
+  if (c == kRoot || m_size[c] == 0) {
     std::cout << "DEAD END at depth " << depth << "\n";
     return;
   }
 
-  std::cout << "Depth " << depth << ": choosing column " << c->name
-            << " (id=" << c->colID << ") with " << c->size << " rows\n";
+  std::cout << "Depth " << depth << ": choosing column " << m_columnNames[c - 1]
+            << " (id=" << (c - 1) << ") with " << m_size[c] << " rows\n";
 
   cover(c);
-  for (DLXNode* r = c->D; r != c; r = r->D) {
-    m_solutionRows.push_back(r->rowID);
-    for (DLXNode* j = r->R; j != r; j = j->R) cover(m_columns[j->colID]);
+  for (Link r = m_D[c]; r != c; r = m_D[r]) {
+    m_solutionRows.push_back(m_rowID[r]);
+    for (Link j = m_R[r]; j != r; j = m_R[j]) cover(m_col[j]);
     searchWithDebug(depth + 1);
-    for (DLXNode* j = r->L; j != r; j = j->L) uncover(m_columns[j->colID]);
+    for (Link j = m_L[r]; j != r; j = m_L[j]) uncover(m_col[j]);
     m_solutionRows.pop_back();
   }
   uncover(c);
 }
 
-ColumnNode* DLX::makeColumn(const std::string& name) {
-  auto col = std::make_unique<ColumnNode>(name);
-  ColumnNode* ptr = col.get();
-  m_nodePool.push_back(std::move(col));
-  return ptr;
-}
-
-DLXNode* DLX::makeNode() {
-  auto node = std::make_unique<DLXNode>();
-  DLXNode* ptr = node.get();
-  m_nodePool.push_back(std::move(node));
-  return ptr;
+DLX::Link DLX::makeNode(Link col, int rowID) {
+  const Link node = static_cast<Link>(m_col.size());
+  m_L.push_back(node);
+  m_R.push_back(node);
+  m_U.push_back(node);
+  m_D.push_back(node);
+  m_col.push_back(col);
+  m_rowID.push_back(rowID);
+  if (col == kRoot) {
+    m_size.push_back(0);
+  }
+  return node;
 }
 
 /*
@@ -1,79 +1,475 @@
 #pragma once
 
+#include "copy_order.h"
+#include "instrumentation.h"
 #include "shapes.h"
 
 #include <atomic>
+#include <cstdint>
 #include <functional>
-#include <memory>
+#include <limits>
+#include <new>
+#include <random>
 #include <string>
 #include <vector>
 
-struct DLXNode
+enum class HeuristicMode { None, LeastFilled };
+
+// Remaining piece sizes a dead-region check ran with (minArea 0: no check)
+struct RegionBound
 {
-  DLXNode() : L(this), R(this), U(this), D(this), rowID(-1), colID(-1) {}
-  DLXNode *L, *R, *U, *D;
-  int rowID;
-  int colID;
+  int minArea = 0;
+  int areaGcd = 0;
+
+  bool operator==(const RegionBound& o) const { return minArea == o.minArea && areaGcd == o.areaGcd; }
 };
 
-struct ColumnNode : DLXNode
+// Minimal allocator for arrays that are scanned with vector loads
+template <typename T, size_t Align>
+struct AlignedAllocator
 {
-  ColumnNode(const std::string& n = "") : DLXNode(), size(0), name(n) {}
-  int size;
-  std::string name;
-};
+  using value_type = T;
 
-enum class HeuristicMode { None, LeastFilled };
+  template <typename U>
+  struct rebind { using other = AlignedAllocator<U, Align>; };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+  }
+  void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t{Align}); }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+};
 
+// Dancing Links over a flat, index-based matrix.
+// All nodes live in parallel arrays (structure of arrays) and are addressed by
+// 32-bit indices: node 0 is the root header, nodes 1..numColumns are the column
+// headers, and row nodes follow. Column names are kept out of the hot arrays.
 class DLX
 {
 public:
+  using Link = uint32_t;
+  static constexpr Link kRoot = 0;
+
   // external control/monitoring hooks
   std::function<void(const std::vector<int>&)> handleSolution;
   std::atomic<uint64_t>* p_nodesVisited = nullptr;
   std::atomic<uint64_t>* p_solutionsFound = nullptr;
   std::atomic<bool>* p_stopFlag = nullptr;
+  SearchStats* p_searchStats = nullptr;  // per-depth histograms (optional)
 
   DLX();
   ~DLX() = default;
 
   // Setup DLX columns:
   // Columns represent board cells (0..63) + piece usage constraints (one column per piece)
+  // With optionalPieces the piece columns are secondary: each piece is used
+  // at most once, but a solution may leave pieces unused.
   void setup(const std::vector<Placement>& placements,
              const std::vector<bool>& boardMask,
-             int boardWidth, int boardHeight, int numPieces);
+             int boardWidth, int boardHeight, int numPieces,
+             bool optionalPieces = false);
 
   void setHeuristic(HeuristicMode);
 
-  int addColumn(const std::string& name);
+  // Search identical pieces in one order only (see CopyOrder); 'placements'
+  // are the ones passed to setup()
+  void setIdenticalPieces(const std::vector<Placement>& placements, const std::vector<int>& previousCopy);
+
+  // False if the copy order rules the row out in the current position
+  bool rowAllowed(int rowID) const { return !m_copyOrder.active() || m_copyOrder.allows(rowID); }
+
+  // Columns must all be added before the first row. Secondary columns are
+  // not linked into the header ring: they are never chosen for branching and
+  // need not be covered, but still allow at most one row.
+  int addColumn(const std::string& name, bool primary = true);
 
   void addRow(int rowID, const std::vector<int>& cols);
 
-  void cover(ColumnNode* c);
+  // c is a column header node (column index + 1)
+  void cover(Link c);
+
+  void uncover(Link c);
 
-  void uncover(ColumnNode* c);
+  // Return the column header node to branch on, or kRoot if no column is left
+  Link chooseColumnNone() const;
 
-  ColumnNode* chooseColumnNone() const;
+  // Same choice as chooseColumnNone(); in this mode the search additionally
+  // prunes nodes that leave a region of free cells no set of the remaining
+  // pieces can fill (see hasDeadRegion)
+  Link chooseColumnLeastFilled() const;
 
-  ColumnNode* chooseColumnLeastFilled() const;
+  Link chooseColumn() const;
 
-  ColumnNode* chooseColumn() const;
+  // Break ties between equally small columns at random instead of taking the
+  // first one (seed 0 restores the deterministic choice)
+  void setRandomTieBreak(uint64_t seed);
 
-  void search(int k = 0);
+  // Relink the rows of every column in random order, which changes the order
+  // in which the search tries them. Only valid outside of a search with no
+  // row selected.
+  void shuffleRows(std::mt19937_64& rng);
+
+  // Run the whole search to completion
+  void search();
+
+  // Search driven by a visitor whose hooks are resolved at compile time:
+  //   void onSolution(const std::vector<int>& rows);
+  //   void onNode(int depth);   // every search node entered
+  //   bool shouldStop();        // polled once per node
+  // Empty hooks compile away. Node counts and per-depth statistics are still
+  // batched into p_nodesVisited and p_searchStats; the pointer hooks above
+  // are only used by the visitors below.
+  template <class Visitor>
+  void search(Visitor& visitor);
+
+  // step() with a visitor; see step(uint64_t) below
+  template <class Visitor>
+  bool step(Visitor& visitor, uint64_t maxNodes);
   void searchWithDebug(int k = 0);
 
+  // Resumable search on an explicit stack. beginSearch() resets the stack,
+  // step(n) enters at most n search nodes and returns true while work remains,
+  // resume() runs until the search is finished (or the stop flag is raised).
+  void beginSearch();
+  bool step(uint64_t maxNodes);
+  void resume();
+
+  // Count-only variant of the search: leaves only bump a local counter, so
+  // handleSolution is never called and no solution is materialized. The local
+  // count is added to p_solutionsFound at the end of every countStep().
+  bool countStep(uint64_t maxNodes);
+  uint64_t countSolutions();
+  uint64_t solutionCount() const { return m_solutionCount; }
+
+  // Count the subtree below each row of the first branching column.
+  // onBranch(rowID, count) is called as soon as a branch is finished.
+  uint64_t countSolutionsPerBranch(const std::function<void(int, uint64_t)>& onBranch);
+
+  // Undo every row on the stack and leave the matrix as it was at beginSearch()
+  void abandonSearch();
+
+  // Rows chosen by the search since beginSearch(), one per depth. While the
+  // search is suspended by step(), feeding this path to replayPath() right
+  // after beginSearch() on an identical matrix restores the same position.
+  std::vector<int> searchPath() const;
+
+  // Throws std::runtime_error if a row is not in the column the search
+  // would branch on at that depth
+  void replayPath(const std::vector<int>& rows);
+
+  // Give away the untried sibling rows at the shallowest level of a suspended
+  // search. Each returned prefix (full row path, including rows selected before
+  // beginSearch) can be replayed elsewhere; this search will no longer visit them.
+  std::vector<std::vector<int>> donateWork();
+
+  // Take free board cells out of the puzzle (e.g. the holes of one of many
+  // masks over the same board) by covering their columns, which also hides
+  // every row touching them. restoreCells() takes the same list and undoes it.
+  // Throws std::invalid_argument for a cell that is not currently free.
+  void removeCells(const std::vector<int>& cells);
+  void restoreCells(const std::vector<int>& cells);
+
+  // Apply/undo one row outside of the search, e.g. to replay a prefix.
+  // Rows must be unselected in reverse order.
+  void selectRow(int rowID);
+  void unselectRow(int rowID);
+
+  // One random root-to-leaf path for Knuth's tree size estimate. The probe
+  // makes the same choices as the search (column choice, dead-region check),
+  // picks a row uniformly at random at every level and undoes its rows
+  // before returning. 'nodes' is the sum over the path of the product of the
+  // branching factors above each node; 'solutions' is that product at a
+  // solution leaf (else 0). Both are unbiased estimates of the totals.
+  struct ProbeResult
+  {
+    double nodes = 0.0;
+    double solutions = 0.0;
+  };
+  ProbeResult probe(std::mt19937_64& rng);
+
+  // Rows of the column the search would branch on next, without those the
+  // copy order rules out (empty at a dead end)
+  std::vector<int> branchRows() const;
+
+  bool isSolved() const { return m_R[kRoot] == kRoot; }
+
+  bool searchFinished() const { return m_phase == SearchPhase::Done; }
+  int depth() const { return m_level; }
+  const std::vector<int>& currentRows() const { return m_solutionRows; }
+
+  size_t numColumns() const { return m_columnNames.size(); }
+  size_t numNodes() const { return m_col.size(); }
+
+  // Publish batched node counts and per-depth statistics now
+  void flushCounters();
+
+  // Visitor behind step()/search(): the std::function and atomic pointer hooks
+  struct CallbackVisitor
+  {
+    DLX& dlx;
+
+    void onSolution(const std::vector<int>& rows) {
+      // Publish the node count first; solution handlers may report it
+      dlx.flushCounters();
+      if (dlx.handleSolution) dlx.handleSolution(rows);
+      if (dlx.p_solutionsFound) dlx.p_solutionsFound->fetch_add(1);
+    }
+    void onNode(int) {}
+    bool shouldStop() const {
+      return dlx.p_stopFlag && dlx.p_stopFlag->load(std::memory_order_relaxed);
+    }
+  };
+
+  // Visitor behind countStep(): leaves only bump a counter
+  struct CountVisitor
+  {
+    uint64_t& count;
+    const std::atomic<bool>* stopFlag = nullptr;
+
+    void onSolution(const std::vector<int>&) { ++count; }
+    void onNode(int) {}
+    bool shouldStop() const { return stopFlag && stopFlag->load(std::memory_order_relaxed); }
+  };
+
 private:
+  enum class SearchPhase : uint8_t { Enter, TryRow, Backtrack, Done };
+
+  // One level of the explicit search stack
+  struct Frame
+  {
+    Link column; // column branched on at this level
+    Link row;    // row currently being tried in that column
+    Link last;   // last row to try before the rest was donated (kRoot = none)
+  };
+
   HeuristicMode m_heuristic = HeuristicMode::None;
-  ColumnNode* m_header = nullptr;
-  std::vector<ColumnNode*> m_columns;
+  bool m_randomTies = false;
+  mutable std::mt19937_64 m_tieRng;
+
+  // Hot data: links, owning column header and row ID per node
+  std::vector<Link> m_L, m_R, m_U, m_D;
+  std::vector<Link> m_col;
+  std::vector<int> m_rowID;
+
+  // First node of each row, indexed by row ID (kRoot if the row was skipped)
+  std::vector<Link> m_rowNode;
+
+  // Number of rows per column, indexed by column header node. Columns that
+  // cannot be chosen (the root, secondary and covered columns) carry
+  // kInactive on top of their size, so chooseColumnNone() is a plain argmin
+  // over this dense array instead of a walk around the header ring.
+  static constexpr int kInactive = 1 << 29;
+  std::vector<int, AlignedAllocator<int, 32>> m_size;
+
+  // Vector argmin over m_size for the running CPU, if it has one; otherwise
+  // chooseColumnNone() walks the header ring
+  size_t (*m_argmin)(const int*, size_t) = nullptr;
+
+  // Cold data: column names, indexed by column index
+  std::vector<std::string> m_columnNames;
+
   std::vector<int> m_solutionRows;
-  std::vector<std::unique_ptr<DLXNode>> m_nodePool; // owns all nodes
 
-  ColumnNode* makeColumn(const std::string& name);
+  CopyOrder m_copyOrder;
+  bool m_optionalCopies = false;  // copy order must be checked at solutions
+
+  // Board geometry for dead-region pruning (empty if setup() was not used)
+  int m_numCellColumns = 0;
+  int m_removedCells = 0;           // cells taken out by removeCells()
+  std::vector<Link> m_cellColumn;   // board cell -> column header (kRoot = hole)
+  std::vector<int> m_columnCell;    // column header -> board cell (-1 = not a cell)
+  std::vector<int> m_neighbors;     // 4 per board cell, -1 padded
+  std::vector<Link> m_pieceColumns;
+  bool m_optionalPieces = false;
+  std::vector<int> m_pieceArea;     // cells per piece, parallel to m_pieceColumns
+  std::vector<uint32_t> m_visited;  // flood fill stamps
+  uint32_t m_visitStamp = 0;
+  std::vector<int> m_fillStack;
+
+  std::vector<RegionBound> m_regionBound;  // by level
+
+  std::vector<Frame> m_stack;
+  int m_level = 0;
+  size_t m_baseDepth = 0; // rows selected before beginSearch()
+  SearchPhase m_phase = SearchPhase::Done;
+  uint64_t m_solutionCount = 0;
+
+  // Node counts are kept locally and added to p_nodesVisited in batches,
+  // together with the per-depth counters
+  static constexpr uint64_t kFlushNodes = 1 << 12;
+  uint64_t m_pendingNodes = 0;
+  SearchCounters m_counters;
+
+  template <class Visitor>
+  bool runSearch(Visitor& visitor, uint64_t maxNodes);
+
+  bool isCovered(Link c) const { return m_R[m_L[c]] != c; }
 
-  DLXNode* makeNode();
+  // Smallest active column, ties broken with m_tieRng
+  Link chooseColumnRandomTie() const;
+
+  // True if a connected region of free cells is smaller than the smallest
+  // remaining piece or not a multiple of the gcd of the remaining piece sizes.
+  // 'parent' is the bound the parent node passed its check with. If 'bound',
+  // set to the current one, equals it, only regions next to 'row' are
+  // checked, as the others are as they were in the parent; otherwise (and for
+  // kRoot) the whole board is.
+  bool hasDeadRegion(Link row, const RegionBound& parent, RegionBound& bound);
+
+  Link makeNode(Link col, int rowID);
 };
 
 
+// The cover/uncover pair is the inner loop of every search, so it is
+// defined here where the templated search can inline it
+inline void DLX::cover(Link c) {
+  Link* const L = m_L.data();
+  Link* const R = m_R.data();
+  Link* const U = m_U.data();
+  Link* const D = m_D.data();
+  const Link* const col = m_col.data();
+  int* const size = m_size.data();
+
+  R[L[c]] = R[c];
+  L[R[c]] = L[c];
+  size[c] += kInactive;
+  for (Link i = D[c]; i != c; i = D[i])
+    for (Link j = R[i]; j != i; j = R[j]) {
+      U[D[j]] = U[j];
+      D[U[j]] = D[j];
+      size[col[j]]--;
+    }
+}
+
+inline void DLX::uncover(Link c) {
+  Link* const L = m_L.data();
+  Link* const R = m_R.data();
+  Link* const U = m_U.data();
+  Link* const D = m_D.data();
+  const Link* const col = m_col.data();
+  int* const size = m_size.data();
+
+  for (Link i = U[c]; i != c; i = U[i])
+    for (Link j = L[i]; j != i; j = L[j]) {
+      size[col[j]]++;
+      U[D[j]] = j;
+      D[U[j]] = j;
+    }
+  R[L[c]] = c;
+  L[R[c]] = c;
+  size[c] -= kInactive;
+}
+
+template <class Visitor>
+void DLX::search(Visitor& visitor) {
+  beginSearch();
+  while (step(visitor, std::numeric_limits<uint64_t>::max())) {
+  }
+}
+
+template <class Visitor>
+bool DLX::step(Visitor& visitor, uint64_t maxNodes) {
+  const bool more = runSearch(visitor, maxNodes);
+  flushCounters();
+  return more;
+}
+
+template <class Visitor>
+bool DLX::runSearch(Visitor& visitor, uint64_t maxNodes) {
+  uint64_t budget = maxNodes;
+
+  while (true) {
+    switch (m_phase) {
+    case SearchPhase::Enter: {
+      if (visitor.shouldStop()) {
+        abandonSearch();
+        return false;
+      }
+      const int depth = static_cast<int>(m_baseDepth) + m_level;
+      if (m_R[kRoot] == kRoot) {
+        if (!m_optionalCopies || m_copyOrder.usesFirstCopies()) {
+          m_counters.solution(depth);
+          visitor.onSolution(m_solutionRows);
+        }
+        m_phase = SearchPhase::Backtrack;
+        break;
+      }
+      if (budget == 0) return true;
+      --budget;
+      if (++m_pendingNodes == kFlushNodes) flushCounters();
+      m_counters.node(depth);
+      visitor.onNode(depth);
+
+      if (m_heuristic == HeuristicMode::LeastFilled &&
+          hasDeadRegion(m_level > 0 ? m_stack[m_level - 1].row : kRoot,
+                        m_level > 0 ? m_regionBound[m_level - 1] : RegionBound{},
+                        m_regionBound[m_level])) {
+        m_counters.pruned(depth);
+        m_phase = SearchPhase::Backtrack;
+        break;
+      }
+
+      const Link c = chooseColumn();
+      m_counters.branch(depth, c == kRoot ? 0 : m_size[c]);
+      if (c == kRoot || m_size[c] == 0) {
+        m_phase = SearchPhase::Backtrack;
+        break;
+      }
+
+      cover(c);
+      m_stack[m_level] = Frame{c, m_D[c], kRoot};
+      m_phase = SearchPhase::TryRow;
+      break;
+    }
+
+    case SearchPhase::TryRow: {
+      Frame& f = m_stack[m_level];
+      if (f.row == f.column) {
+        uncover(f.column);
+        m_phase = SearchPhase::Backtrack;
+        break;
+      }
+      if (m_copyOrder.active()) {
+        if (!m_copyOrder.allows(m_rowID[f.row])) {
+          f.row = (f.row == f.last) ? f.column : m_D[f.row];
+          break;
+        }
+        m_copyOrder.place(m_rowID[f.row]);
+      }
+      m_solutionRows.push_back(m_rowID[f.row]);
+      for (Link j = m_R[f.row]; j != f.row; j = m_R[j]) cover(m_col[j]);
+      ++m_level;
+      m_phase = SearchPhase::Enter;
+      break;
+    }
+
+    case SearchPhase::Backtrack: {
+      if (m_level == 0) {
+        m_phase = SearchPhase::Done;
+        return false;
+      }
+      Frame& f = m_stack[--m_level];
+      for (Link j = m_L[f.row]; j != f.row; j = m_L[j]) uncover(m_col[j]);
+      m_solutionRows.pop_back();
+      if (m_copyOrder.active()) m_copyOrder.unplace(m_rowID[f.row]);
+      f.row = (f.row == f.last) ? f.column : m_D[f.row];
+      m_phase = SearchPhase::TryRow;
+      break;
+    }
+
+    case SearchPhase::Done:
+      return false;
+    }
+  }
+}
+
 // void debugDLX(DLX& dlx, const std::vector<Placement>& placements,
 //               int boardWidth, int boardHeight);
@@ -0,0 +1,41 @@
+#include "estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+void TreeEstimator::add(const DLX::ProbeResult& probe)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ++m_count;
+  const double n = static_cast<double>(m_count);
+  const double delta = probe.nodes - m_meanNodes;
+  m_meanNodes += delta / n;
+  m_m2Nodes += delta * (probe.nodes - m_meanNodes);
+  m_meanSolutions += (probe.solutions - m_meanSolutions) / n;
+}
+
+TreeEstimate TreeEstimator::estimate() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  TreeEstimate e;
+  e.probes = m_count;
+  e.nodes = m_meanNodes;
+  e.solutions = m_meanSolutions;
+  if (m_count > 1) {
+    const double stdErr = std::sqrt(m_m2Nodes / static_cast<double>(m_count - 1) / static_cast<double>(m_count));
+    e.nodesLow = std::max(0.0, m_meanNodes - 1.96 * stdErr);
+    e.nodesHigh = m_meanNodes + 1.96 * stdErr;
+  }
+  else {
+    e.nodesLow = e.nodesHigh = m_meanNodes;
+  }
+  return e;
+}
+
+void TreeEstimator::run(DLX& dlx, std::mt19937_64& rng, uint64_t probes, const std::atomic<bool>* stop)
+{
+  for (uint64_t i = 0; probes == 0 || i < probes; ++i) {
+    if (stop && stop->load(std::memory_order_relaxed)) break;
+    add(dlx.probe(rng));
+  }
+}
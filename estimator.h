@@ -0,0 +1,38 @@
+#pragma once
+
+#include "dlx.h"
+
+#include <cstdint>
+#include <mutex>
+#include <random>
+
+struct TreeEstimate
+{
+  uint64_t probes = 0;
+  double nodes = 0.0;      // estimated nodes in the whole search tree
+  double nodesLow = 0.0;   // 95% confidence interval (normal approximation)
+  double nodesHigh = 0.0;
+  double solutions = 0.0;
+};
+
+// Knuth's Monte Carlo estimate of the DLX search tree. Each probe is one
+// random root-to-leaf path (DLX::probe); the running mean of the probe
+// estimates is unbiased, and its spread gives the confidence interval.
+// add() and estimate() may be called from different threads.
+class TreeEstimator
+{
+public:
+  void add(const DLX::ProbeResult& probe);
+  TreeEstimate estimate() const;
+
+  // Probe until 'probes' probes are done or 'stop' is raised (probes == 0:
+  // until stopped). The matrix must not be searched at the same time.
+  void run(DLX& dlx, std::mt19937_64& rng, uint64_t probes, const std::atomic<bool>* stop);
+
+private:
+  mutable std::mutex m_mutex;
+  uint64_t m_count = 0;
+  double m_meanNodes = 0.0;
+  double m_m2Nodes = 0.0;  // Welford sum of squared deviations
+  double m_meanSolutions = 0.0;
+};
@@ -0,0 +1,140 @@
+#include "feasibility.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace
+{
+struct Coloring
+{
+  const char* name;
+  int classes;
+  int (*color)(int x, int y);
+};
+
+const Coloring kColorings[] = {
+  {"area", 1, [](int, int) { return 0; }},
+  {"checkerboard", 2, [](int x, int y) { return (x + y) % 2; }},
+  {"column stripes mod 2", 2, [](int x, int) { return x % 2; }},
+  {"row stripes mod 2", 2, [](int, int y) { return y % 2; }},
+  {"column stripes mod 3", 3, [](int x, int) { return x % 3; }},
+  {"row stripes mod 3", 3, [](int, int y) { return y % 3; }},
+  {"diagonals mod 3", 3, [](int x, int y) { return (x + y) % 3; }},
+  {"anti-diagonals mod 3", 3, [](int x, int y) { return (x + 2 * y) % 3; }},
+};
+
+std::string describeCounts(const std::vector<int>& counts)
+{
+  std::ostringstream out;
+  for (size_t c = 0; c < counts.size(); ++c) out << (c ? "/" : "") << counts[c];
+  return out.str();
+}
+}
+
+FeasibilityResult checkFeasibility(const std::vector<Placement>& placements,
+                                   const std::vector<bool>& mask,
+                                   int W, int H, int numPieces, bool optionalPieces,
+                                   const std::vector<int>& previousCopy)
+{
+  FeasibilityResult result;
+
+  // Identical pieces form one group, taken in a single step
+  std::vector<int> groupOf(static_cast<size_t>(numPieces));
+  std::vector<int> copies;
+  for (int p = 0; p < numPieces; ++p) {
+    const int prev = previousCopy[static_cast<size_t>(p)];
+    if (prev < 0) {
+      groupOf[static_cast<size_t>(p)] = static_cast<int>(copies.size());
+      copies.push_back(0);
+    }
+    else {
+      groupOf[static_cast<size_t>(p)] = groupOf[static_cast<size_t>(prev)];
+    }
+    ++copies[static_cast<size_t>(groupOf[static_cast<size_t>(p)])];
+  }
+
+  for (const Coloring& coloring : kColorings) {
+    const int k = coloring.classes;
+    std::vector<int> target(static_cast<size_t>(k), 0);
+    for (int y = 0; y < H; ++y) {
+      for (int x = 0; x < W; ++x) {
+        if (mask[static_cast<size_t>(y * W + x)]) ++target[static_cast<size_t>(coloring.color(x, y))];
+      }
+    }
+
+    // Sums are kept as mixed-radix indices; no component may exceed the target
+    std::vector<size_t> radix(static_cast<size_t>(k), 1);
+    size_t numStates = 1;
+    for (int c = 0; c < k && numStates <= kMaxFeasibilityStates; ++c) {
+      radix[c] = numStates;
+      numStates *= static_cast<size_t>(target[c]) + 1;
+    }
+    if (numStates > kMaxFeasibilityStates) {
+      result.notes.push_back(std::string(coloring.name) + " coloring skipped: more than " +
+                             std::to_string(kMaxFeasibilityStates) + " color count vectors");
+      continue;
+    }
+
+    // Distinct color count vectors (as index offsets) per group of copies
+    std::vector<std::vector<size_t>> offsets(copies.size());
+    for (const Placement& pl : placements) {
+      std::vector<int> counts(static_cast<size_t>(k), 0);
+      for (int cell : pl.cells) ++counts[static_cast<size_t>(coloring.color(cell % W, cell / W))];
+      size_t offset = 0;
+      bool fits = true;
+      for (int c = 0; c < k; ++c) {
+        fits = fits && counts[c] <= target[c];
+        offset += static_cast<size_t>(counts[c]) * radix[c];
+      }
+      if (fits) offsets[static_cast<size_t>(groupOf[static_cast<size_t>(pl.pieceID)])].push_back(offset);
+    }
+
+    // Adding per component keeps the digits apart only if none overflows
+    auto addFits = [&](size_t s, size_t offset) {
+      if (s + offset >= numStates) return false;
+      for (int c = 0; c < k; ++c) {
+        const size_t base = static_cast<size_t>(target[c]) + 1;
+        if ((s / radix[c]) % base + (offset / radix[c]) % base > static_cast<size_t>(target[c])) return false;
+      }
+      return true;
+    };
+
+    // picks[s]: bit j is set if s is reachable with j copies of the current
+    // group. Offsets are positive, so one pass in index order is enough.
+    std::vector<char> reachable(numStates, 0);
+    std::vector<uint64_t> picks(numStates);
+    reachable[0] = 1;
+    for (size_t g = 0; g < copies.size(); ++g) {
+      std::vector<size_t>& list = offsets[g];
+      std::sort(list.begin(), list.end());
+      list.erase(std::unique(list.begin(), list.end()), list.end());
+
+      // Up to 63 copies at a time, so every count has its bit
+      for (int left = copies[g]; left > 0; left -= 63) {
+        const int m = std::min(left, 63);
+        const uint64_t keep = (uint64_t{2} << m) - 1;
+        for (size_t s = 0; s < numStates; ++s) picks[s] = reachable[s] ? 1 : 0;
+        for (size_t s = 0; s < numStates; ++s) {
+          const uint64_t more = (picks[s] << 1) & keep;
+          if (!more) continue;
+          for (size_t offset : list) {
+            if (addFits(s, offset)) picks[s + offset] |= more;
+          }
+        }
+        for (size_t s = 0; s < numStates; ++s) {
+          reachable[s] = optionalPieces ? picks[s] != 0 : ((picks[s] >> m) & 1) != 0;
+        }
+      }
+    }
+
+    if (!reachable[numStates - 1]) {
+      result.feasible = false;
+      result.reason = (k == 1)
+        ? "no choice of piece placements covers exactly the " + describeCounts(target) + " free cells"
+        : std::string(coloring.name) + " coloring: the free cells split " + describeCounts(target) +
+          " by color, which no choice of piece placements covers exactly";
+      return result;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "shapes.h"
+
+#include <string>
+#include <vector>
+
+struct FeasibilityResult
+{
+  bool feasible = true;
+  std::string reason;  // the invariant that rules out every tiling
+  std::vector<std::string> notes;  // colorings skipped as too large to check
+};
+
+// Cheap necessary conditions for a tiling, checked before any search. For
+// each coloring of the board (one color, i.e. plain area; checkerboard;
+// stripes and diagonals mod 2 and 3), every placement covers a fixed number
+// of cells of each color, so the pieces must be able to pick one placement
+// each (or none, if optional) whose color counts add up to exactly those of
+// the free cells. That is a small subset-sum over count vectors, with all
+// copies of an identical piece (chained by previousCopy, see previousCopies())
+// taken in one step. Colorings with more than kMaxFeasibilityStates count
+// vectors are skipped. Passing every check does not mean a tiling exists.
+constexpr size_t kMaxFeasibilityStates = size_t{1} << 20;
+
+FeasibilityResult checkFeasibility(const std::vector<Placement>& placements,
+                                   const std::vector<bool>& mask,
+                                   int W, int H, int numPieces, bool optionalPieces,
+                                   const std::vector<int>& previousCopy);
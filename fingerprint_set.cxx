@@ -0,0 +1,155 @@
+#include "fingerprint_set.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <istream>
+#include <ostream>
+
+namespace
+{
+constexpr size_t kInitialSlots = 16;
+
+// splitmix64 finalizer
+uint64_t mix(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ull;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+bool isEmpty(const Fingerprint& fp) { return (fp.hi | fp.lo) == 0; }
+}
+
+Fingerprint fingerprintOf(const std::string& form)
+{
+  // Two lanes over 8-byte words, each through its own mixing chain
+  uint64_t h1 = 0x9E3779B97F4A7C15ull ^ form.size();
+  uint64_t h2 = 0xC2B2AE3D27D4EB4Full + form.size();
+  for (size_t i = 0; i < form.size(); i += 8) {
+    uint64_t word = 0;
+    for (size_t b = 0; b < 8 && i + b < form.size(); ++b) {
+      word |= static_cast<uint64_t>(static_cast<unsigned char>(form[i + b])) << (8 * b);
+    }
+    h1 = mix(h1 ^ word);
+    h2 = mix(h2 ^ (word * 0xFF51AFD7ED558CCDull));
+  }
+
+  Fingerprint fp;
+  fp.hi = mix(h1 + h2);
+  fp.lo = mix(h2 ^ ((h1 << 23) | (h1 >> 41)));
+  if (isEmpty(fp)) fp.lo = 1;
+  return fp;
+}
+
+std::ostream& operator<<(std::ostream& out, const Fingerprint& fp)
+{
+  char buf[33];
+  std::snprintf(buf, sizeof(buf), "%016llx%016llx",
+                static_cast<unsigned long long>(fp.hi), static_cast<unsigned long long>(fp.lo));
+  return out << buf;
+}
+
+std::istream& operator>>(std::istream& in, Fingerprint& fp)
+{
+  std::string hex;
+  if (!(in >> hex)) return in;
+  if (hex.size() != 32 || hex.find_first_not_of("0123456789abcdef") != std::string::npos) {
+    in.setstate(std::ios::failbit);
+    return in;
+  }
+  fp.hi = std::stoull(hex.substr(0, 16), nullptr, 16);
+  fp.lo = std::stoull(hex.substr(16), nullptr, 16);
+  return in;
+}
+
+FingerprintSet::FingerprintSet()
+  : m_shards(kShards)
+{
+}
+
+bool FingerprintSet::insert(const std::string& form)
+{
+  return insert(fingerprintOf(form), m_verify ? &form : nullptr);
+}
+
+bool FingerprintSet::insert(const Fingerprint& fp)
+{
+  return insert(fp, nullptr);
+}
+
+bool FingerprintSet::insert(const Fingerprint& fp, const std::string* form)
+{
+  Shard& shard = m_shards[static_cast<size_t>(fp.hi >> (64 - kShardBits))];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if ((shard.count + 1) * 4 > shard.slots.size() * 3) grow(shard);
+
+  const size_t mask = shard.slots.size() - 1;
+  size_t i = static_cast<size_t>(fp.lo) & mask;
+  bool collided = false;  // passed an entry with the same fingerprint but another form
+  for (; !isEmpty(shard.slots[i]); i = (i + 1) & mask) {
+    if (!(shard.slots[i] == fp)) continue;
+    if (!form || shard.forms[i].empty() || shard.forms[i] == *form) return false;
+    collided = true;
+  }
+  // Only a new form counts, not repeats of one already stored
+  if (collided) m_collisions.fetch_add(1);
+  shard.slots[i] = fp;
+  if (m_verify && form) shard.forms[i] = *form;
+  ++shard.count;
+  return true;
+}
+
+void FingerprintSet::grow(Shard& shard)
+{
+  std::vector<Fingerprint> slots(std::max(kInitialSlots, 2 * shard.slots.size()));
+  std::vector<std::string> forms(m_verify ? slots.size() : 0);
+  const size_t mask = slots.size() - 1;
+  for (size_t k = 0; k < shard.slots.size(); ++k) {
+    const Fingerprint& fp = shard.slots[k];
+    if (isEmpty(fp)) continue;
+    size_t i = static_cast<size_t>(fp.lo) & mask;
+    while (!isEmpty(slots[i])) i = (i + 1) & mask;
+    slots[i] = fp;
+    if (m_verify) forms[i] = std::move(shard.forms[k]);
+  }
+  shard.slots = std::move(slots);
+  shard.forms = std::move(forms);
+}
+
+size_t FingerprintSet::size() const
+{
+  size_t n = 0;
+  for (const Shard& shard : m_shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    n += shard.count;
+  }
+  return n;
+}
+
+size_t FingerprintSet::memoryBytes() const
+{
+  size_t bytes = 0;
+  for (const Shard& shard : m_shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    bytes += shard.slots.capacity() * sizeof(Fingerprint) + shard.forms.capacity() * sizeof(std::string);
+    for (const std::string& form : shard.forms) {
+      if (form.capacity() > sizeof(std::string)) bytes += form.capacity() + 1;
+    }
+  }
+  return bytes;
+}
+
+std::vector<Fingerprint> FingerprintSet::fingerprints() const
+{
+  std::vector<Fingerprint> all;
+  for (const Shard& shard : m_shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (const Fingerprint& fp : shard.slots) {
+      if (!isEmpty(fp)) all.push_back(fp);
+    }
+  }
+  std::sort(all.begin(), all.end());
+  return all;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 128-bit hash of a canonical solution form. Never all zero.
+struct Fingerprint
+{
+  uint64_t hi = 0;
+  uint64_t lo = 0;
+
+  bool operator==(const Fingerprint& o) const { return hi == o.hi && lo == o.lo; }
+  bool operator<(const Fingerprint& o) const { return hi != o.hi ? hi < o.hi : lo < o.lo; }
+};
+
+Fingerprint fingerprintOf(const std::string& form);
+
+// As 32 hex digits
+std::ostream& operator<<(std::ostream& out, const Fingerprint& fp);
+std::istream& operator>>(std::istream& in, Fingerprint& fp);
+
+// Set of solution fingerprints, 16 bytes per entry instead of a heap string.
+// The top hash bits pick one of kShards open-addressing tables (linear
+// probing, doubled at 3/4 load), each behind its own mutex, so threads that
+// report solutions only wait for each other when they hit the same shard.
+//
+// With verification on, every entry also keeps its canonical form, and a
+// fingerprint match is only a duplicate if the forms agree as well; anything
+// else is stored as a new entry and counted as a collision (once per form, not
+// per repeat). Entries inserted by fingerprint alone (e.g. loaded from a file)
+// match on the fingerprint.
+class FingerprintSet
+{
+public:
+  static constexpr int kShardBits = 6;
+  static constexpr int kShards = 1 << kShardBits;
+
+  FingerprintSet();
+
+  // Only before the first insert
+  void setVerify(bool verify) { m_verify = verify; }
+  bool verifying() const { return m_verify; }
+
+  // True if the form was not in the set yet
+  bool insert(const std::string& form);
+  bool insert(const Fingerprint& fp);
+  // Form under a fingerprint already computed by the caller; form may be null
+  bool insert(const Fingerprint& fp, const std::string* form);
+
+  size_t size() const;
+  size_t memoryBytes() const;
+  uint64_t collisions() const { return m_collisions.load(); }
+
+  // All entries, sorted
+  std::vector<Fingerprint> fingerprints() const;
+
+private:
+  struct Shard
+  {
+    mutable std::mutex mutex;
+    std::vector<Fingerprint> slots;  // all zero = empty
+    std::vector<std::string> forms;  // parallel to slots when verifying
+    size_t count = 0;
+  };
+
+  bool m_verify = false;
+  std::vector<Shard> m_shards;
+  std::atomic<uint64_t> m_collisions{0};
+
+  void grow(Shard& shard);
+};
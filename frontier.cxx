@@ -0,0 +1,214 @@
+#include "frontier.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+std::string UInt128::toString() const
+{
+  if (hi == 0) return std::to_string(lo);
+
+  uint32_t limbs[4] = {static_cast<uint32_t>(hi >> 32), static_cast<uint32_t>(hi),
+                       static_cast<uint32_t>(lo >> 32), static_cast<uint32_t>(lo)};
+  std::string digits;
+  while (limbs[0] | limbs[1] | limbs[2] | limbs[3]) {
+    uint64_t rem = 0;
+    for (uint32_t& limb : limbs) {
+      const uint64_t cur = (rem << 32) | limb;
+      limb = static_cast<uint32_t>(cur / 10);
+      rem = cur % 10;
+    }
+    digits.push_back(static_cast<char>('0' + rem));
+  }
+  std::reverse(digits.begin(), digits.end());
+  return digits;
+}
+
+void FrontierCounter::setup(const std::vector<Placement>& placements,
+                            const std::vector<bool>& boardMask,
+                            int boardWidth, int boardHeight,
+                            int numPieces, bool optionalPieces)
+{
+  if (numPieces > kMaxPieces) {
+    throw std::runtime_error("The frontier engine supports at most " + std::to_string(kMaxPieces) + " pieces.");
+  }
+  m_allPieces = numPieces == 64 ? ~uint64_t{0} : (uint64_t{1} << numPieces) - 1;
+  m_optionalPieces = optionalPieces;
+
+  // Rank the usable cells along the long axis, then across it
+  const bool alongX = boardWidth >= boardHeight;
+  auto major = [&](int cell) { return alongX ? cell % boardWidth : cell / boardWidth; };
+  auto minor = [&](int cell) { return alongX ? cell / boardWidth : cell % boardWidth; };
+
+  std::vector<int> cells;
+  for (int i = 0; i < boardWidth * boardHeight; ++i) {
+    if (boardMask[i]) cells.push_back(i);
+  }
+  std::sort(cells.begin(), cells.end(), [&](int a, int b) {
+    return std::make_pair(major(a), minor(a)) < std::make_pair(major(b), minor(b));
+  });
+  m_numCells = static_cast<int>(cells.size());
+  std::vector<int> rankOf(boardMask.size(), -1);
+  for (int r = 0; r < m_numCells; ++r) rankOf[static_cast<size_t>(cells[r])] = r;
+
+  m_candidates.clear();
+  m_byFirst.assign(static_cast<size_t>(m_numCells), {});
+  m_window = 1;
+  for (size_t i = 0; i < placements.size(); ++i) {
+    const Placement& pl = placements[i];
+    if (std::any_of(pl.cells.begin(), pl.cells.end(), [&](int c) { return !boardMask[c]; })) continue;
+
+    std::vector<int> ranks;
+    for (int cell : pl.cells) ranks.push_back(rankOf[static_cast<size_t>(cell)]);
+    const auto [lo, hi] = std::minmax_element(ranks.begin(), ranks.end());
+    const int first = *lo;
+    const int span = *hi - first + 1;
+    if (span > kMaxWindow) {
+      throw std::runtime_error("The frontier engine supports placements spanning at most " +
+                               std::to_string(kMaxWindow) + " cells of the sweep, one spans " +
+                               std::to_string(span) + ".");
+    }
+    m_window = std::max(m_window, span);
+
+    Candidate c;
+    c.rowID = static_cast<int>(i);
+    c.piece = uint64_t{1} << pl.pieceID;
+    c.needs = 0;
+    for (int r : ranks) c.cells.set(r - first);
+    m_byFirst[static_cast<size_t>(first)].push_back(static_cast<int>(m_candidates.size()));
+    m_candidates.push_back(c);
+  }
+
+  m_needs.assign(static_cast<size_t>(numPieces), 0);
+  m_copyLabels = CopyLabels();
+}
+
+void FrontierCounter::setIdenticalPieces(const std::vector<Placement>& placements, const std::vector<int>& previousCopy)
+{
+  for (size_t p = 0; p < m_needs.size(); ++p) {
+    m_needs[p] = previousCopy[p] < 0 ? 0 : uint64_t{1} << previousCopy[p];
+  }
+  for (Candidate& c : m_candidates) {
+    c.needs = m_needs[static_cast<size_t>(placements[static_cast<size_t>(c.rowID)].pieceID)];
+  }
+  m_copyLabels.setup(placements, previousCopy);
+}
+
+uint64_t FrontierCounter::countSolutions()
+{
+  sweep(nullptr);
+  const uint64_t count = m_count.hi ? std::numeric_limits<uint64_t>::max() : m_count.lo;
+  if (p_solutionsFound) p_solutionsFound->fetch_add(count);
+  return count;
+}
+
+uint64_t FrontierCounter::countSolutionsPerBranch(const std::function<void(int, uint64_t)>& onBranch)
+{
+  const uint64_t total = countSolutions();
+  if (onBranch) onBranch(-1, total);
+  return total;
+}
+
+void FrontierCounter::search()
+{
+  std::vector<Layer> layers;
+  sweep(&layers);
+  if (stopped() || m_count.isZero()) return;
+
+  // Going backwards, replace every state's count by its number of completions,
+  // so the walk below never enters a dead end
+  for (auto& [s, n] : layers.back()) n = isFinal(s) ? UInt128(1) : UInt128();
+  for (int pos = m_numCells - 1; pos >= 0; --pos) {
+    const Layer& next = layers[static_cast<size_t>(pos + 1)];
+    for (auto& [s, n] : layers[static_cast<size_t>(pos)]) {
+      UInt128 completions;
+      expand(pos, s, [&](const State& t, int) {
+        const auto it = next.find(t);
+        if (it != next.end()) completions += it->second;
+      });
+      n = completions;
+    }
+  }
+
+  std::vector<int> rows;
+  uint64_t nodes = 0;
+  std::function<void(int, const State&)> walk = [&](int pos, const State& s) {
+    if (stopped()) return;
+    ++nodes;
+    if (pos == m_numCells) {
+      if (handleSolution) handleSolution(m_copyLabels.canonical(rows));
+      if (p_solutionsFound) p_solutionsFound->fetch_add(1);
+      return;
+    }
+    const Layer& next = layers[static_cast<size_t>(pos + 1)];
+    expand(pos, s, [&](const State& t, int rowID) {
+      const auto it = next.find(t);
+      if (it == next.end() || it->second.isZero()) return;
+      if (rowID >= 0) rows.push_back(rowID);
+      walk(pos + 1, t);
+      if (rowID >= 0) rows.pop_back();
+    });
+  };
+  walk(0, State{});
+  if (p_nodesVisited) p_nodesVisited->fetch_add(nodes);
+}
+
+template <typename F>
+void FrontierCounter::expand(int pos, const State& s, const F& f) const
+{
+  auto shifted = [](Window w) {
+    w.w[0] = (w.w[0] >> 1) | (w.w[1] << 63);
+    w.w[1] >>= 1;
+    return w;
+  };
+
+  if (s.window.test(0)) {
+    State t = s;
+    t.window = shifted(s.window);
+    f(t, -1);
+    return;
+  }
+  for (int ci : m_byFirst[static_cast<size_t>(pos)]) {
+    const Candidate& c = m_candidates[static_cast<size_t>(ci)];
+    if ((c.piece & s.used) || (c.needs & ~s.used) || s.window.intersects(c.cells)) continue;
+    State t;
+    t.window = shifted(s.window | c.cells);
+    t.used = s.used | c.piece;
+    f(t, c.rowID);
+  }
+}
+
+void FrontierCounter::sweep(std::vector<Layer>* layers)
+{
+  m_count = UInt128();
+  m_peakStates = 1;
+  if (layers) layers->clear();
+
+  Layer current;
+  current[State{}] = UInt128(1);
+  for (int pos = 0; pos < m_numCells; ++pos) {
+    if (stopped()) return;
+    Layer next;
+    next.reserve(current.size());
+    for (const auto& [s, n] : current) {
+      expand(pos, s, [&](const State& t, int) { next[t] += n; });
+    }
+    if (p_nodesVisited) p_nodesVisited->fetch_add(current.size());
+    m_peakStates = std::max(m_peakStates, next.size());
+    if (layers) layers->push_back(std::move(current));
+    current = std::move(next);
+  }
+
+  for (const auto& [s, n] : current) {
+    if (isFinal(s)) m_count += n;
+  }
+  if (layers) layers->push_back(std::move(current));
+}
+
+// Copies are used in order along the sweep, so the ones in use are always
+// the first of their shape
+bool FrontierCounter::isFinal(const State& s) const
+{
+  return m_optionalPieces || s.used == m_allPieces;
+}
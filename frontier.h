@@ -0,0 +1,134 @@
+#pragma once
+
+#include "bitboard.h"
+#include "copy_order.h"
+#include "dlx.h"
+#include "shapes.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Unsigned 128-bit counter, enough for any count a sweep can produce
+struct UInt128
+{
+  uint64_t hi = 0;
+  uint64_t lo = 0;
+
+  UInt128() = default;
+  UInt128(uint64_t v) : lo(v) {}
+
+  UInt128& operator+=(const UInt128& o) {
+    lo += o.lo;
+    hi += o.hi + (lo < o.lo ? 1 : 0);
+    return *this;
+  }
+  bool isZero() const { return (hi | lo) == 0; }
+
+  std::string toString() const;
+};
+
+// Transfer-matrix counting ("frontier DP"). Usable cells are ranked along the
+// board's long axis and swept in that order, always filling the cell at the
+// sweep position with a placement whose lowest rank it is. A state is the
+// occupancy of the next few ranks (as far as a placement reaches) plus the set
+// of pieces used, and each step maps the counts of all states at one rank to
+// the next. Memory is governed by the short side of the board, which makes
+// long thin boards cheap however many solutions they have.
+//
+// search() keeps every step's states to walk the solutions afterwards, so it
+// needs far more memory than counting. Copies of identical pieces are numbered
+// along the sweep and relabeled to the DLX order when reported.
+class FrontierCounter
+{
+public:
+  static constexpr int kMaxWindow = 128;
+  static constexpr int kMaxPieces = 64;
+
+  // external control/monitoring hooks
+  std::function<void(const std::vector<int>&)> handleSolution;
+  std::atomic<uint64_t>* p_nodesVisited = nullptr;
+  std::atomic<uint64_t>* p_solutionsFound = nullptr;
+  std::atomic<bool>* p_stopFlag = nullptr;
+
+  // Throws std::runtime_error if there are more than kMaxPieces pieces or a
+  // placement spans more than kMaxWindow ranks
+  void setup(const std::vector<Placement>& placements,
+             const std::vector<bool>& boardMask,
+             int boardWidth, int boardHeight, int numPieces,
+             bool optionalPieces = false);
+
+  // The sweep order is fixed
+  void setHeuristic(HeuristicMode) {}
+
+  // Search identical pieces in one order only: copy k needs copy k-1
+  void setIdenticalPieces(const std::vector<Placement>& placements, const std::vector<int>& previousCopy);
+
+  void search();
+  // Counts above 2^64 - 1 are returned as that value; see exactCount()
+  uint64_t countSolutions();
+  // Counts are not split by branch; reports the total for the root
+  uint64_t countSolutionsPerBranch(const std::function<void(int, uint64_t)>& onBranch);
+
+  const UInt128& exactCount() const { return m_count; }
+  int windowRanks() const { return m_window; }
+  size_t peakStates() const { return m_peakStates; }
+
+private:
+  using Window = Bits<kMaxWindow / 64>;
+
+  struct State
+  {
+    Window window;  // bit i: rank pos + i is covered
+    uint64_t used = 0;
+
+    bool operator==(const State& o) const { return used == o.used && window == o.window; }
+  };
+
+  struct StateHash
+  {
+    size_t operator()(const State& s) const {
+      uint64_t h = s.used * 0x9E3779B97F4A7C15ull;
+      h ^= (s.window.w[0] + (h >> 29)) * 0xBF58476D1CE4E5B9ull;
+      h ^= (s.window.w[1] + (h >> 31)) * 0x94D049BB133111EBull;
+      return static_cast<size_t>(h ^ (h >> 32));
+    }
+  };
+
+  using Layer = std::unordered_map<State, UInt128, StateHash>;
+
+  struct Candidate
+  {
+    int rowID;
+    uint64_t piece;
+    uint64_t needs;  // bit of the previous copy, which must already be used
+    Window cells;    // relative to the candidate's lowest rank
+  };
+
+  bool m_optionalPieces = false;
+  uint64_t m_allPieces = 0;
+  int m_numCells = 0;
+  int m_window = 1;
+
+  std::vector<Candidate> m_candidates;
+  std::vector<std::vector<int>> m_byFirst;  // candidates by their lowest rank
+  std::vector<uint64_t> m_needs;            // by piece
+
+  CopyLabels m_copyLabels;
+
+  UInt128 m_count;
+  size_t m_peakStates = 0;
+
+  bool stopped() const { return p_stopFlag && p_stopFlag->load(std::memory_order_relaxed); }
+
+  // Calls f(next state, row ID or -1) for every way to move past rank pos
+  template <typename F>
+  void expand(int pos, const State& s, const F& f) const;
+
+  // Forward sweep; keeps all layers if 'layers' is given
+  void sweep(std::vector<Layer>* layers);
+  bool isFinal(const State& s) const;
+};
@@ -0,0 +1,60 @@
+#include "instrumentation.h"
+
+#include <iomanip>
+#include <ostream>
+
+void SearchStats::add(int depth, const DepthStats& d)
+{
+  Bucket& b = m_buckets[static_cast<size_t>(depth)];
+  if (d.nodes) b.nodes.fetch_add(d.nodes, std::memory_order_relaxed);
+  if (d.solutions) b.solutions.fetch_add(d.solutions, std::memory_order_relaxed);
+  if (d.branches) b.branches.fetch_add(d.branches, std::memory_order_relaxed);
+  if (d.deadEnds) b.deadEnds.fetch_add(d.deadEnds, std::memory_order_relaxed);
+  if (d.pruned) b.pruned.fetch_add(d.pruned, std::memory_order_relaxed);
+}
+
+std::vector<DepthStats> SearchStats::snapshot() const
+{
+  std::vector<DepthStats> depths(kMaxDepth);
+  size_t used = 0;
+  for (size_t i = 0; i < depths.size(); ++i) {
+    const Bucket& b = m_buckets[i];
+    DepthStats& d = depths[i];
+    d.nodes = b.nodes.load(std::memory_order_relaxed);
+    d.solutions = b.solutions.load(std::memory_order_relaxed);
+    d.branches = b.branches.load(std::memory_order_relaxed);
+    d.deadEnds = b.deadEnds.load(std::memory_order_relaxed);
+    d.pruned = b.pruned.load(std::memory_order_relaxed);
+    if (d.nodes || d.solutions) used = i + 1;
+  }
+  depths.resize(used);
+  return depths;
+}
+
+void SearchStats::print(std::ostream& out, const std::vector<DepthStats>& depths)
+{
+  out << " depth           nodes       solutions  avg branch       dead ends          pruned\n";
+  for (size_t i = 0; i < depths.size(); ++i) {
+    const DepthStats& d = depths[i];
+    const uint64_t branched = d.nodes - d.pruned;
+    const double avgBranch = branched ? static_cast<double>(d.branches) / static_cast<double>(branched) : 0.0;
+    out << std::setw(6) << i
+        << std::setw(16) << d.nodes
+        << std::setw(16) << d.solutions
+        << std::setw(12) << std::fixed << std::setprecision(2) << avgBranch
+        << std::setw(16) << d.deadEnds
+        << std::setw(16) << d.pruned << "\n";
+  }
+}
+
+#if TESSELLINX_INSTRUMENTATION
+void SearchCounters::flushTo(SearchStats* stats)
+{
+  for (int i = 0; i <= m_deepest; ++i) {
+    DepthStats& d = m_depths[static_cast<size_t>(i)];
+    if (stats) stats->add(i, d);
+    d = DepthStats{};
+  }
+  m_deepest = -1;
+}
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Per-depth search histograms. Set TESSELLINX_INSTRUMENTATION to 0 (CMake
+// option of the same name) to compile the counters out of the search loop.
+#ifndef TESSELLINX_INSTRUMENTATION
+#define TESSELLINX_INSTRUMENTATION 1
+#endif
+
+struct DepthStats
+{
+  uint64_t nodes = 0;
+  uint64_t solutions = 0;
+  uint64_t branches = 0;  // sum of the branching factors chosen at this depth
+  uint64_t deadEnds = 0;  // nodes whose chosen column had no rows
+  uint64_t pruned = 0;    // nodes cut by the dead-region check
+};
+
+// Shared view of the histograms, fed by SearchCounters::flushTo(). Depths
+// from kMaxDepth - 1 on share the last bucket.
+class SearchStats
+{
+public:
+  static constexpr int kMaxDepth = 128;
+
+  void add(int depth, const DepthStats& d);
+
+  // Trimmed after the deepest depth that saw a node or solution
+  std::vector<DepthStats> snapshot() const;
+
+  static void print(std::ostream& out, const std::vector<DepthStats>& depths);
+
+private:
+  struct Bucket
+  {
+    std::atomic<uint64_t> nodes{0};
+    std::atomic<uint64_t> solutions{0};
+    std::atomic<uint64_t> branches{0};
+    std::atomic<uint64_t> deadEnds{0};
+    std::atomic<uint64_t> pruned{0};
+  };
+
+  std::array<Bucket, kMaxDepth> m_buckets;
+};
+
+// Counters owned by one search (one thread): plain increments, published in
+// batches with flushTo()
+class SearchCounters
+{
+public:
+#if TESSELLINX_INSTRUMENTATION
+  void node(int depth) { at(depth).nodes++; }
+  void solution(int depth) { at(depth).solutions++; }
+  void pruned(int depth) { at(depth).pruned++; }
+  void branch(int depth, int rows) {
+    DepthStats& d = at(depth);
+    d.branches += static_cast<uint64_t>(rows);
+    if (rows == 0) d.deadEnds++;
+  }
+  void flushTo(SearchStats* stats);
+#else
+  void node(int) {}
+  void solution(int) {}
+  void pruned(int) {}
+  void branch(int, int) {}
+  void flushTo(SearchStats*) {}
+#endif
+
+private:
+#if TESSELLINX_INSTRUMENTATION
+  std::array<DepthStats, SearchStats::kMaxDepth> m_depths{};
+  int m_deepest = -1;  // deepest bucket touched since the last flush
+
+  DepthStats& at(int depth) {
+    if (depth >= SearchStats::kMaxDepth) depth = SearchStats::kMaxDepth - 1;
+    if (depth > m_deepest) m_deepest = depth;
+    return m_depths[static_cast<size_t>(depth)];
+  }
+#endif
+};
@@ -17,10 +17,25 @@ https://puzzler.sourceforge.net/docs/polyominoes.html
 /// @todo we seem to get more solutions. maybe diagonal flip needs to be accounted for to remove duplicates and get unique solutions?
 /// @todo pipes between steps?
 
+#include "bitboard.h"
+#include "batch.h"
+#include "checkpoint.h"
+#include "dancing_cells.h"
 #include "dlx.h"
+#include "estimator.h"
+#include "feasibility.h"
+#include "fingerprint_set.h"
+#include "frontier.h"
+#include "mitm.h"
+#include "parallel.h"
+#include "reduction.h"
+#include "restarts.h"
+#include "shard.h"
 #include "reporting.h"
 #include "shapes.h"
+#include "symmetry.h"
 #include "video.h"
+#include "zdd.h"
 
 #include <CLI/CLI.hpp>
 
@@ -32,41 +47,15 @@ https://puzzler.sourceforge.net/docs/polyominoes.html
 #include <fstream>
 #include <iostream>
 #include <mutex>
-#include <set>
+#include <random>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
 namespace {
-// Store all canonical solutions here
-static std::set<std::string> uniqueSolutions;
-
-enum SymmetryOp {
-  ROT_0,
-  ROT_90,
-  ROT_180,
-  ROT_270,
-  REFLECT_X,   // horizontal flip (mirror over vertical axis)
-  REFLECT_Y,   // vertical flip (mirror over horizontal axis)
-  REFLECT_D1,  // reflect over main diagonal (y = x)
-  REFLECT_D2   // reflect over anti-diagonal (y = -x)
-};
-
-// Apply a symmetry to (x, y) coordinates
-void transformCoord(int x, int y, int W, int H, SymmetryOp op, int& nx, int& ny)
-{
-  switch (op) {
-  case ROT_0:     nx = x;         ny = y;         break;
-  case ROT_90:    nx = H - 1 - y; ny = x;         break;
-  case ROT_180:   nx = W - 1 - x; ny = H - 1 - y; break;
-  case ROT_270:   nx = y;         ny = W - 1 - x; break;
-  case REFLECT_X: nx = W - 1 - x; ny = y;         break;
-  case REFLECT_Y: nx = x;         ny = H - 1 - y; break;
-  case REFLECT_D1: nx = y;        ny = x;         break;
-  case REFLECT_D2: nx = H - 1 - y; ny = W - 1 - x; break;
-  }
-}
+// Fingerprints of the canonical forms of all solutions reported so far
+static FingerprintSet uniqueSolutions;
 
 // Apply a symmetry to the whole board
 std::vector<int> applySymmetry(const std::vector<int>& board, int W, int H, SymmetryOp op)
@@ -229,9 +218,7 @@ std::string canonicalFormWithMask(const std::vector<int>& board,
 // Returns true if this is a new symmetry class
 bool isNewSolution(const std::vector<int>& board, int boardWidth, int boardHeight)
 {
-  const std::string cf = canonicalForm(board, boardWidth, boardHeight);
-  const auto [it, inserted] = uniqueSolutions.insert(cf);
-  return inserted;
+  return uniqueSolutions.insert(canonicalForm(board, boardWidth, boardHeight));
 }
 
 // Public: returns true if this solution is a NEW symmetry class (w.r.t. the mask)
@@ -243,9 +230,7 @@ bool isNewSolutionWithMask(const std::vector<int>& board,
                            const std::vector<bool>& mask,
                            int W, int H)
 {
-  std::string cf = canonicalFormWithMask(board, mask, W, H);
-  auto [it, inserted] = uniqueSolutions.insert(std::move(cf));
-  return inserted;
+  return uniqueSolutions.insert(canonicalFormWithMask(board, mask, W, H));
 }
 
 
@@ -362,17 +347,115 @@ void debugPipeline(const std::vector<Piece>& basePieces, int boardW, int boardH)
 }
 
 
+enum class SearchEngine { DLX, Bitboard, DancingCells, MeetInTheMiddle, Frontier };
+
 std::atomic<uint64_t> g_nodesVisited{0};
 std::atomic<uint64_t> g_solutionsFound{0};
 std::atomic<bool> g_stopFlag{false};
+SearchStats g_searchStats;
+TreeEstimator g_treeEstimator;
+
+std::string formatDuration(double seconds)
+{
+  const uint64_t s = static_cast<uint64_t>(std::max(0.0, seconds));
+  std::ostringstream out;
+  if (s >= 86400) out << s / 86400 << "d " << (s % 86400) / 3600 << "h";
+  else if (s >= 3600) out << s / 3600 << "h " << (s % 3600) / 60 << "m";
+  else if (s >= 60) out << s / 60 << "m " << s % 60 << "s";
+  else out << s << "s";
+  return out.str();
+}
+
+void printEstimate(std::ostream& out, const TreeEstimate& e)
+{
+  out << std::scientific << std::setprecision(3)
+      << "Estimate from " << e.probes << " probes: " << e.nodes << " nodes (95% CI "
+      << e.nodesLow << " - " << e.nodesHigh << "), " << e.solutions << " solutions\n"
+      << std::defaultfloat;
+}
 std::mutex csv_mutex;
 
+// Combine the shard files of one split search; returns the exit code
+int mergeShards(const std::vector<std::string>& files)
+{
+  std::vector<ShardResult> shards;
+  try {
+    for (const std::string& file : files) {
+      shards.push_back(loadShardResult(file));
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  const ShardResult& first = shards.front();
+  std::vector<bool> seen(static_cast<size_t>(std::max(first.numShards, 0)), false);
+  for (size_t k = 0; k < shards.size(); ++k) {
+    const ShardResult& r = shards[k];
+    if (r.fingerprint != first.fingerprint || r.config != first.config ||
+        r.numShards != first.numShards || r.dedup != first.dedup ||
+        r.split != first.split || r.totalPrefixes != first.totalPrefixes) {
+      std::cerr << "Shard file '" << files[k] << "' belongs to a different split or puzzle.\n";
+      return 1;
+    }
+    if (r.shard < 0 || r.shard >= r.numShards || seen[static_cast<size_t>(r.shard)]) {
+      std::cerr << "Shard file '" << files[k] << "' repeats or misnumbers shard " << r.shard << ".\n";
+      return 1;
+    }
+    seen[static_cast<size_t>(r.shard)] = true;
+    if (!r.finished) {
+      std::cerr << "Warning: shard " << r.shard << " was stopped early; the total is incomplete.\n";
+    }
+  }
+  bool complete = true;
+  for (size_t i = 0; i < seen.size(); ++i) {
+    if (!seen[i]) std::cerr << "Warning: shard " << i << " of " << first.numShards << " is missing.\n";
+    complete = complete && seen[i];
+  }
+
+  uint64_t nodes = 0, found = 0, reported = 0, prefixes = 0;
+  FingerprintSet forms;
+  for (const ShardResult& r : shards) {
+    nodes += r.nodesVisited;
+    found += r.solutionsFound;
+    reported += r.solutionsReported;
+    prefixes += r.prefixes;
+    complete = complete && r.finished;
+    for (const Fingerprint& fp : r.uniqueForms) forms.insert(fp);
+  }
+
+  // Every prefix belongs to exactly one shard, so a full set adds up to the total
+  if (prefixes > first.totalPrefixes || (complete && prefixes != first.totalPrefixes)) {
+    std::cerr << "Shard files cover " << prefixes << " prefixes, but the split has "
+              << first.totalPrefixes << ".\n";
+    return 1;
+  }
+
+  // Equivalent solutions may turn up in different shards; only the union
+  // of their canonical forms counts each class once
+  std::cout << "Merged " << shards.size() << " of " << first.numShards << " shards (" << prefixes
+            << " prefixes). Total nodes visited: " << nodes << ", solutions found: "
+            << (first.dedup ? forms.size() : reported) << "\n";
+  if (first.dedup) {
+    std::cout << "(" << found << " solutions before removing equivalent ones)\n";
+  }
+  return 0;
+}
+
 // Reporter thread: prints progress every interval seconds
-void reporterThreadFunc(int intervalSec)
+void reporterThreadFunc(int intervalSec, bool printStats)
 {
   using namespace std::chrono_literals;
 
   const auto t0 = std::chrono::steady_clock::now();
+
+  // The node rate for the ETA is measured from the first report that saw
+  // search progress, so time spent on an up-front estimate does not count
+  auto rateStart = t0;
+  uint64_t rateStartNodes = 0;
+  bool rateStarted = false;
+
   while (!g_stopFlag.load())
   {
     std::this_thread::sleep_for(std::chrono::seconds(intervalSec));
@@ -382,7 +465,30 @@ void reporterThreadFunc(int intervalSec)
     const double elapsed = std::chrono::duration<double>(t1 - t0).count();
 
     std::cerr << "[Progress] Time " << std::fixed << std::setprecision(1) << elapsed
-              << "s, Nodes visited: " << nodes << ", Solutions found: " << sols << "\n";
+              << "s, Nodes visited: " << nodes << ", Solutions found: " << sols;
+
+    const TreeEstimate e = g_treeEstimator.estimate();
+    if (e.probes > 0 && e.nodes > 0.0) {
+      std::cerr << ", " << std::setprecision(1) << std::min(100.0, 100.0 * static_cast<double>(nodes) / e.nodes)
+                << "% of estimate";
+      const double rateTime = std::chrono::duration<double>(t1 - rateStart).count();
+      if (rateStarted && nodes > rateStartNodes && rateTime > 0.0) {
+        const double rate = static_cast<double>(nodes - rateStartNodes) / rateTime;
+        auto eta = [&](double total) { return (total - static_cast<double>(nodes)) / rate; };
+        std::cerr << ", ETA " << formatDuration(eta(e.nodes))
+                  << " (" << formatDuration(eta(e.nodesLow)) << " - " << formatDuration(eta(e.nodesHigh)) << ")";
+      }
+    }
+    std::cerr << "\n";
+
+    if (!rateStarted && nodes > 0) {
+      rateStarted = true;
+      rateStart = t1;
+      rateStartNodes = nodes;
+    }
+    if (printStats) {
+      SearchStats::print(std::cerr, g_searchStats.snapshot());
+    }
   }
 }
 
@@ -391,29 +497,102 @@ int main(int argc, char* argv[])
   int maxSolutions = 0; // 0 = unlimited
   int progressInterval = 0;
   bool uniqueSolutions = false;
+  bool verifyUnique = false;
   bool print = false;
   bool saveSVG = false;
   bool saveVideo = false;
-
+  bool countOnly = false;
+  bool optionalPieces = false;
+  bool printStats = false;
+  bool reduce = false;
+  bool expandIdentical = false;
+  bool firstSolution = false;
+  std::string shardSpec;
+  int shardDepth = 3;
+  int shardProbes = 0;
+  std::string shardFile;
+  std::vector<std::string> mergeShardFiles;
+  uint64_t restartNodes = 4096;
+  uint64_t estimateProbes = 0;
+  bool estimateOnly = false;
+  bool backgroundEstimate = false;
+  size_t memoMB = 0;
+  int numThreads = 1;
+  int splitDepth = 3;
+  uint64_t seed = 0;
 
   std::string csvFilename;
+  std::string zddOutFile;
+  std::string zddInFile;
+  int zddSamples = 0;
+  bool zddEnumerate = false;
+  std::string checkpointFile;
+  int checkpointInterval = 300;
+  bool resume = false;
+  std::filesystem::path batchFile;
   HeuristicMode heuristic = HeuristicMode::LeastFilled;
+  SearchEngine engine = SearchEngine::DLX;
 
   CLI::App app{"Pentomino solver"};
 
   app.add_option("--progress-interval", progressInterval, "Progress report interval in seconds (0 = none)");
+  app.add_flag("--stats", printStats, "Print per-depth search statistics (dlx engine) with progress reports and at the end");
+  app.add_option("--estimate", estimateProbes, "Estimate the search tree size from this many random probes before searching (dlx engine)");
+  app.add_flag("--estimate-only", estimateOnly, "Stop after the estimate")->needs("--estimate");
+  app.add_flag("--background-estimate", backgroundEstimate, "Keep refining the estimate on another thread during the search (dlx engine)");
   app.add_option("--max-solutions", maxSolutions, "Maximum number of solutions to find (0 = unlimited)");
   app.add_flag("--unique-solutions", uniqueSolutions, "Only output unique solutions");
+  app.add_flag("--verify-unique", verifyUnique, "Also keep the canonical forms of unique solutions to rule out fingerprint collisions")
+    ->needs("--unique-solutions");
   app.add_flag("--print", print, "Print solutions to terminal");
   app.add_flag("--svg", saveSVG, "Save solutions as SVG files");
   app.add_flag("--video", saveVideo, "Save all boards for video creation");
+  app.add_flag("--optional-pieces", optionalPieces, "Pieces may be left unused (each is still used at most once)");
+  app.add_flag("--reduce", reduce, "Drop placements that can never be part of a solution before searching");
+  app.add_flag("--expand-identical", expandIdentical, "Also report the solution count with identical pieces told apart");
+  app.add_flag("--count-only", countOnly, "Only count solutions (total and per first-level branch)");
+  app.add_option("--memo-mb", memoMB, "Memoize subtree counts in a table of this many MB (count-only, bitboard engine)");
+  app.add_option("--threads", numThreads, "Number of search threads (1 = search on the main thread)");
+  app.add_option("--split-depth", splitDepth, "Tree depth down to which work is split between threads");
+  app.add_option("--zdd-file", zddOutFile, "Build a ZDD of all solutions and save it to this file (bitboard-sized boards)");
+  app.add_option("--zdd-input", zddInFile, "Load a ZDD saved with --zdd-file instead of searching");
+  app.add_option("--zdd-sample", zddSamples, "Report this many uniformly random solutions from the ZDD")->needs("--zdd-input");
+  app.add_flag("--zdd-enumerate", zddEnumerate, "Report every solution stored in the ZDD")->needs("--zdd-input");
+  app.add_option("--checkpoint-file", checkpointFile, "Periodically save the search position to this file (single-threaded dlx)");
+  app.add_option("--checkpoint-interval", checkpointInterval, "Seconds between checkpoints")->needs("--checkpoint-file");
+  app.add_flag("--resume", resume, "Continue the search saved in --checkpoint-file")->needs("--checkpoint-file");
+  app.add_flag("--first-solution", firstSolution, "Stop at the first solution, searching with randomized restarts (dlx engine)")
+    ->excludes("--count-only")->excludes("--checkpoint-file")->excludes("--zdd-file")->excludes("--zdd-input");
+  app.add_option("--restart-nodes", restartNodes, "Node budget unit for --first-solution restarts (Luby schedule)")
+    ->needs("--first-solution");
+  app.add_option("--shard", shardSpec, "Search only shard i of N (\"i/N\", 0-based) of the tree prefixes (dlx engine)")
+    ->excludes("--checkpoint-file")->excludes("--zdd-file")->excludes("--zdd-input")->excludes("--first-solution");
+  app.add_option("--shard-depth", shardDepth, "Depth of the tree prefixes that are dealt out to shards")->needs("--shard");
+  app.add_option("--shard-probes", shardProbes, "Balance shards by subtree sizes estimated from this many probes per prefix")
+    ->needs("--shard");
+  app.add_option("--shard-file", shardFile, "Where --shard writes its results (default shard_<i>_of_<N>.txt)")->needs("--shard");
+  app.add_option("--merge-shards", mergeShardFiles, "Combine the results of shard files written by --shard, then exit");
+  app.add_option("--batch-file", batchFile, "Count solutions for every mask or hole list in this file on the same board (dlx engine)")
+    ->excludes("--unique-solutions")->excludes("--checkpoint-file")->excludes("--zdd-file")->excludes("--zdd-input")
+    ->excludes("--estimate")->excludes("--background-estimate")->excludes("--reduce")
+    ->excludes("--first-solution")->excludes("--shard");
+  app.add_option("--seed", seed, "Random seed (0 = pick one at random)");
   app.add_option("--csv", csvFilename, "Save solutions in CSV format to given filename");
-  app.add_option("--heuristic", heuristic, "Heuristic to use: none | least-filled")->transform(
+  app.add_option("--heuristic", heuristic, "Heuristic to use: none | least-filled (also prunes unfillable regions with dlx and dancing-cells)")->transform(
     CLI::CheckedTransformer(std::map<std::string, HeuristicMode>{
                               {"none", HeuristicMode::None},
                               {"least-filled", HeuristicMode::LeastFilled}
                             },
                             CLI::ignore_case));
+  app.add_option("--engine", engine, "Search engine: dlx | bitboard | dancing-cells | mitm | frontier")->transform(
+    CLI::CheckedTransformer(std::map<std::string, SearchEngine>{
+                              {"dlx", SearchEngine::DLX},
+                              {"bitboard", SearchEngine::Bitboard},
+                              {"dancing-cells", SearchEngine::DancingCells},
+                              {"mitm", SearchEngine::MeetInTheMiddle},
+                              {"frontier", SearchEngine::Frontier}
+                            },
+                            CLI::ignore_case));
 
   // Board options:
   int boardWidth = 8;
@@ -447,6 +626,30 @@ int main(int argc, char* argv[])
 
   CLI11_PARSE(app, argc, argv);
 
+  if (!mergeShardFiles.empty()) {
+    return mergeShards(mergeShardFiles);
+  }
+  ::uniqueSolutions.setVerify(verifyUnique);
+
+  int shardIndex = 0;
+  int numShards = 1;
+  if (!shardSpec.empty()) {
+    char slash = 0;
+    std::istringstream spec(shardSpec);
+    if (!(spec >> shardIndex >> slash >> numShards) || slash != '/' || !spec.eof() ||
+        numShards < 1 || shardIndex < 0 || shardIndex >= numShards) {
+      std::cerr << "--shard expects i/N with 0 <= i < N, got '" << shardSpec << "'.\n";
+      return 1;
+    }
+    if (engine != SearchEngine::DLX) {
+      std::cerr << "--shard needs the dlx engine.\n";
+      return 1;
+    }
+    if (shardFile.empty()) {
+      shardFile = "shard_" + std::to_string(shardIndex) + "_of_" + std::to_string(numShards) + ".txt";
+    }
+  }
+
   if (saveVideo) {
     std::cout << "Video output enabled:\n"
               << "  Filename: " << videoFilename << "\n"
@@ -529,42 +732,182 @@ int main(int argc, char* argv[])
     std::cout << "\n";
   }
 
+  // Batch masks share the placements of this board, so they may only take
+  // cells away from it
+  std::vector<BatchMask> batchMasks;
+  if (!batchFile.empty()) {
+    if (engine != SearchEngine::DLX) {
+      std::cerr << "--batch-file needs the dlx engine.\n";
+      return 1;
+    }
+    try {
+      batchMasks = loadBatchFile(batchFile, boardWidth, boardHeight);
+    }
+    catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    for (const BatchMask& bm : batchMasks) {
+      for (size_t i = 0; i < bm.mask.size(); ++i) {
+        if (bm.mask[i] && !boardMask[i]) {
+          std::cerr << "Batch entry '" << bm.label << "' uses cell (" << i % boardWidth << ","
+                    << i / boardWidth << "), which is a hole of the board.\n";
+          return 1;
+        }
+      }
+    }
+    std::cout << "Batch of " << batchMasks.size() << " masks from " << batchFile << "\n";
+  }
+
   debugPipeline(pieces, boardWidth, boardHeight);
 
   // return 0;
 
-  const std::vector<Placement> placements = enumeratePlacements(
+  std::vector<Placement> placements = enumeratePlacements(
     pieces, boardWidth, boardHeight, boardMask);
 
+  // Coloring invariants rule out many boards before any search. Batch masks
+  // are different boards, so they are not checked against this one.
+  if (batchFile.empty()) {
+    const FeasibilityResult fr = checkFeasibility(placements, boardMask, boardWidth, boardHeight,
+                                                  static_cast<int>(pieces.size()), optionalPieces,
+                                                  previousCopies(pieces));
+    for (const std::string& note : fr.notes) std::cerr << "Note: " << note << ".\n";
+    if (!fr.feasible) {
+      std::cout << "No solutions: " << fr.reason << "\n"
+                << "Search finished. Total nodes visited: 0, solutions found: 0\n";
+      return 0;
+    }
+  }
+
+  if (reduce) {
+    const ReductionStats rs = reducePlacements(placements, boardMask, boardWidth, boardHeight,
+                                               static_cast<int>(pieces.size()), optionalPieces);
+    std::cout << "Reduction: " << rs.isolatingRemoved + rs.conflictingRemoved << " of "
+              << rs.inputPlacements << " placements removed (" << rs.isolatingRemoved
+              << " isolate a region, " << rs.conflictingRemoved << " conflict with "
+              << rs.forcedPlacements << " forced placements) in " << rs.rounds << " rounds\n";
+    if (rs.infeasible) {
+      std::cout << "No solutions after reduction: " << rs.reason << "\n"
+                << "Search finished. Total nodes visited: 0, solutions found: 0\n";
+      return 0;
+    }
+  }
+
+  // Identical pieces are searched in one order only, so every tiling is
+  // found once instead of once per permutation of the copies
+  const std::vector<int> previousCopy = previousCopies(pieces);
+  uint64_t copyPermutations = 1;
+  {
+    std::vector<uint64_t> copies(pieces.size(), 1);  // copies up to and including p
+    for (size_t p = 0; p < pieces.size(); ++p) {
+      if (previousCopy[p] < 0) continue;
+      copies[p] = copies[static_cast<size_t>(previousCopy[p])] + 1;
+      copyPermutations *= copies[p];
+    }
+    if (copyPermutations > 1) {
+      std::cout << "Identical pieces are searched in one order; each tiling stands for "
+                << copyPermutations << " solutions with the copies told apart\n";
+    }
+  }
+
+  // For unique solutions, cut the board symmetries out of the search itself.
+  // The canonical-form filter is then only needed if no piece could be
+  // restricted (identical copies are already ordered).
+  bool dedupSolutions = uniqueSolutions;
+  if (uniqueSolutions && !optionalPieces) {
+    const SymmetryBreak sb = breakBoardSymmetry(placements, pieces, boardMask, boardWidth, boardHeight);
+    if (sb.pieceID >= 0) {
+      std::cout << "Board has " << sb.groupSize << " symmetries; piece " << sb.pieceID
+                << " keeps one placement per orbit (" << sb.removedPlacements << " placements removed)\n";
+    }
+    dedupSolutions = sb.groupSize > 1 && sb.pieceID < 0;
+  }
+
 
   std::vector<std::string> colors;
   for (const auto& p : pieces) {
     colors.emplace_back(p.color);
   }
 
-  DLX dlx;
-  dlx.setup(placements, boardMask, boardWidth, boardHeight, static_cast<int>(pieces.size()));
-  dlx.setHeuristic(heuristic);
-  dlx.p_nodesVisited = &g_nodesVisited;
-  dlx.p_solutionsFound = &g_solutionsFound;
-  dlx.p_stopFlag = &g_stopFlag;
+  const int numPieces = static_cast<int>(pieces.size());
+
+  if ((engine == SearchEngine::Bitboard || !zddOutFile.empty()) && !BitboardSolver<2>::fits(boardMask, numPieces)) {
+    std::cerr << "The bitboard engine supports at most " << BitboardSolver<2>::kMaxCells
+              << " usable cells and " << BitboardSolver<2>::kMaxPieces << " pieces.\n";
+    return 1;
+  }
+  if (memoMB > 0 && !(countOnly && engine == SearchEngine::Bitboard)) {
+    std::cerr << "Note: --memo-mb needs --count-only and --engine bitboard; ignoring it.\n";
+  }
+  if (printStats && (!TESSELLINX_INSTRUMENTATION || engine != SearchEngine::DLX)) {
+    std::cerr << "Note: per-depth statistics need the dlx engine and a build with TESSELLINX_INSTRUMENTATION.\n";
+    printStats = false;
+  }
+  if (engine != SearchEngine::DLX && (estimateProbes > 0 || backgroundEstimate)) {
+    std::cerr << "Note: tree size estimates are only available for the dlx engine.\n";
+  }
+  if (firstSolution && engine != SearchEngine::DLX) {
+    std::cerr << "--first-solution needs the dlx engine.\n";
+    return 1;
+  }
+  if (engine != SearchEngine::DLX && engine != SearchEngine::MeetInTheMiddle && numThreads > 1) {
+    std::cerr << "Note: --threads is only supported by the dlx and mitm engines; searching on one thread.\n";
+  }
+
+  // Checkpoints capture the explicit stack of the single-threaded DLX search
+  const bool checkpointing = !checkpointFile.empty();
+  if (checkpointing && (engine != SearchEngine::DLX || numThreads > 1 ||
+                        !zddInFile.empty() || !zddOutFile.empty())) {
+    std::cerr << "Checkpoints are only supported by the single-threaded dlx search.\n";
+    return 1;
+  }
+
+  const uint64_t fingerprint = checkpointing
+    ? puzzleFingerprint(placements, boardMask, boardWidth, boardHeight,
+                        static_cast<int>(heuristic), optionalPieces)
+    : 0;
+
+  Checkpoint checkpoint;
+  if (resume) {
+    try {
+      checkpoint = loadCheckpoint(checkpointFile);
+    }
+    catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    if (checkpoint.fingerprint != fingerprint || checkpoint.countOnly != countOnly) {
+      std::cerr << "Checkpoint '" << checkpointFile << "' was written for a different puzzle or mode.\n";
+      return 1;
+    }
+    std::cout << "Resuming at depth " << checkpoint.path.size() << " after "
+              << checkpoint.nodesVisited << " nodes and " << checkpoint.solutionsFound << " solutions\n";
+  }
 
   std::ofstream csvOut;
   bool csvEnabled = !csvFilename.empty();
 
   if (csvEnabled) {
-    csvOut.open(csvFilename);
+    // On resume, drop rows written after the checkpoint and append from there
+    const bool appendCSV = resume && std::filesystem::exists(csvFilename);
+    if (appendCSV) {
+      std::filesystem::resize_file(csvFilename, checkpoint.csvBytes);
+    }
+    csvOut.open(csvFilename, appendCSV ? std::ios::app : std::ios::trunc);
     if (!csvOut) {
       std::cerr << "Failed to open CSV file '" << csvFilename << "' for writing.\n";
       return 1;
     }
-    csvOut << "SolutionID,NodeVisited,PlacementID,PieceID,Cells\n";
+    if (!appendCSV) {
+      csvOut << "SolutionID,NodeVisited,PlacementID,PieceID,Cells\n";
+    }
   }
 
   // Run reporter thread
   std::thread reporterThread;
   if (progressInterval > 0) {
-    reporterThread = std::thread(reporterThreadFunc, progressInterval);
+    reporterThread = std::thread(reporterThreadFunc, progressInterval, printStats);
   }
 
   std::vector<int> board(boardWidth * boardHeight, -1); // board for printing solutions
@@ -572,11 +915,30 @@ int main(int argc, char* argv[])
   std::size_t solutionCounter = 0;
   std::mutex printMutex;
 
-  dlx.handleSolution = [&](const std::vector<int>& solutionRows)
+  if (resume) {
+    g_nodesVisited.store(checkpoint.nodesVisited);
+    g_solutionsFound.store(checkpoint.solutionsFound);
+    solutionCounter = checkpoint.solutionsReported;
+    for (const Fingerprint& fp : checkpoint.uniqueForms) ::uniqueSolutions.insert(fp);
+  }
+
+  const std::function<void(const std::vector<int>&)> handleSolution = [&](const std::vector<int>& solutionRows)
   {
     bool reportSolution = true;
 
-    if (uniqueSolutions) {
+    if (print || saveSVG || saveVideo || dedupSolutions)
+    {
+      std::fill(board.begin(), board.end(), -1);
+
+      for (int r : solutionRows) {
+        const Placement& pl = placements[static_cast<size_t>(r)];
+        for (int c : pl.cells) {
+          board[static_cast<size_t>(c)] = pl.pieceID;
+        }
+      }
+    }
+
+    if (dedupSolutions) {
       // Symmetry filter that respects holes
       reportSolution = isNewSolutionWithMask(board, boardMask, boardWidth, boardHeight);
 
@@ -589,18 +951,6 @@ int main(int argc, char* argv[])
       ++solutionCounter;
     }
 
-    if (print || saveSVG || saveVideo)
-    {
-      std::fill(board.begin(), board.end(), -1);
-
-      for (int r : solutionRows) {
-        const Placement& pl = placements[static_cast<size_t>(r)];
-        for (int c : pl.cells) {
-          board[static_cast<size_t>(c)] = pl.pieceID;
-        }
-      }
-    }
-
     if (print && reportSolution) {
       std::lock_guard<std::mutex> lock(printMutex);
       std::cout << "Solution #" << solutionCounter << ":\n";
@@ -643,7 +993,377 @@ int main(int argc, char* argv[])
   };
 
 
-  dlx.search();
+  // Count-only: report the subtree count below each first-level row
+  auto printBranchCount = [&](int r, uint64_t count)
+  {
+    std::lock_guard<std::mutex> lock(printMutex);
+    if (r < 0) {
+      std::cout << "Branch (root): " << count << " solutions\n";
+      return;
+    }
+    const Placement& pl = placements[static_cast<size_t>(r)];
+    std::cout << "Branch placement " << r << " (piece " << pl.pieceID << ", cells ";
+    for (size_t ci = 0; ci < pl.cells.size(); ++ci) {
+      std::cout << pl.cells[ci] << (ci + 1 < pl.cells.size() ? ";" : "");
+    }
+    std::cout << "): " << count << " solutions\n";
+  };
+
+  if (countOnly && dedupSolutions) {
+    std::cerr << "Note: --count-only skips the canonical-form filter; counts may include equivalent solutions.\n";
+  }
+
+  // All engines take the same placements and report through the same hooks
+  auto configureEngine = [&](auto& solver)
+  {
+    solver.setup(placements, boardMask, boardWidth, boardHeight, numPieces, optionalPieces);
+    solver.setHeuristic(heuristic);
+    solver.setIdenticalPieces(placements, previousCopy);
+    solver.p_nodesVisited = &g_nodesVisited;
+    solver.p_solutionsFound = &g_solutionsFound;
+    solver.p_stopFlag = &g_stopFlag;
+    solver.handleSolution = handleSolution;
+  };
+
+  auto runEngine = [&](auto& solver)
+  {
+    if (countOnly) {
+      solutionCounter = solver.countSolutionsPerBranch(printBranchCount);
+    }
+    else {
+      solver.search();
+    }
+  };
+
+  auto runBitboard = [&](auto& solver)
+  {
+    configureEngine(solver);
+    if (countOnly && memoMB > 0) {
+      solver.setMemoTableSize(memoMB << 20);
+    }
+    runEngine(solver);
+
+    if (countOnly && memoMB > 0) {
+      const auto& stats = solver.memoStats();
+      std::cout << "Memo table: " << (solver.memoTableBytes() >> 20) << " MB, "
+                << stats.lookups << " lookups, " << stats.hits << " hits, "
+                << stats.stores << " stores, " << stats.replacements << " replacements\n";
+    }
+  };
+
+  // The ZDD is built by the bitboard engine, whose lowest-cell branching
+  // keeps variables ordered along every path. Its file records the puzzle,
+  // since rows only mean something for the placements they were built from.
+  const uint64_t zddFingerprint = (!zddInFile.empty() || !zddOutFile.empty())
+    ? puzzleFingerprint(placements, boardMask, boardWidth, boardHeight, 0, optionalPieces)
+    : 0;
+  auto buildZDD = [&](auto& solver)
+  {
+    configureEngine(solver);
+    ZDD zdd;
+    if (!solver.buildZDD(zdd)) {
+      std::cerr << "ZDD construction was interrupted; not saving it.\n";
+      return false;
+    }
+    zdd.setFingerprint(zddFingerprint);
+    try {
+      zdd.save(zddOutFile);
+    }
+    catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return false;
+    }
+    solutionCounter = zdd.count();
+    std::cout << "ZDD: " << zdd.numNodes() << " nodes, " << solutionCounter
+              << " solutions, saved to " << zddOutFile << "\n";
+    return true;
+  };
+
+  // Step the DLX search in slices and save its position every interval
+  auto runCheckpointed = [&](DLX& dlx)
+  {
+    dlx.beginSearch();
+    if (resume) {
+      try {
+        dlx.replayPath(checkpoint.path);
+      }
+      catch (const std::exception& e) {
+        std::cerr << "Cannot resume: " << e.what() << "\n";
+        return false;
+      }
+    }
+
+    auto save = [&]() {
+      Checkpoint cp;
+      cp.fingerprint = fingerprint;
+      cp.countOnly = countOnly;
+      cp.nodesVisited = g_nodesVisited.load();
+      cp.solutionsFound = g_solutionsFound.load();
+      cp.solutionsReported = solutionCounter;
+      cp.csvBytes = csvEnabled ? std::filesystem::file_size(csvFilename) : 0;
+      cp.path = dlx.searchPath();
+      cp.uniqueForms = ::uniqueSolutions.fingerprints();
+      saveCheckpoint(cp, checkpointFile);
+    };
+
+    constexpr uint64_t kSliceNodes = 1 << 16;
+    const auto interval = std::chrono::seconds(checkpointInterval);
+    auto lastSave = std::chrono::steady_clock::now();
+    try {
+      while (countOnly ? dlx.countStep(kSliceNodes) : dlx.step(kSliceNodes)) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastSave >= interval) {
+          save();
+          lastSave = now;
+        }
+      }
+    }
+    catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      dlx.abandonSearch();
+      return false;
+    }
+
+    if (countOnly) {
+      solutionCounter = g_solutionsFound.load();
+    }
+    // A finished search leaves nothing to resume
+    if (dlx.searchFinished() && !g_stopFlag.load()) {
+      std::filesystem::remove(checkpointFile);
+    }
+    return true;
+  };
+
+  if (checkpointing && countOnly) {
+    std::cerr << "Note: with --checkpoint-file, --count-only reports the total only.\n";
+  }
+
+  bool ok = true;
+  if (!zddInFile.empty()) {
+    ZDD zdd;
+    try {
+      zdd = ZDD::load(zddInFile);
+    }
+    catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    if (zdd.fingerprint() != zddFingerprint || zdd.numPlacements() != placements.size()) {
+      std::cerr << "ZDD file '" << zddInFile << "' was built for a different board or piece set.\n";
+      return 1;
+    }
+
+    const uint64_t total = zdd.count();
+    std::cout << "ZDD: " << zdd.numNodes() << " nodes, " << total << " solutions\n";
+    if (zddSamples > 0) {
+      std::mt19937_64 rng(seed != 0 ? seed : std::random_device{}());
+      try {
+        for (int i = 0; i < zddSamples && total > 0 && !g_stopFlag.load(); ++i) {
+          std::vector<int> rows = zdd.sample(rng);
+          g_solutionsFound.fetch_add(1);
+          handleSolution(rows);
+        }
+      }
+      catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+    }
+    else if (zddEnumerate) {
+      zdd.enumerate([&](const std::vector<int>& rows) {
+        g_solutionsFound.fetch_add(1);
+        handleSolution(rows);
+        return !g_stopFlag.load();
+      });
+    }
+    else {
+      solutionCounter = total;
+    }
+  }
+  else if (!zddOutFile.empty()) {
+    if (BitboardSolver<1>::fits(boardMask, numPieces)) {
+      BitboardSolver<1> solver;
+      ok = buildZDD(solver);
+    }
+    else {
+      BitboardSolver<2> solver;
+      ok = buildZDD(solver);
+    }
+  }
+  else if (engine == SearchEngine::Bitboard) {
+    if (BitboardSolver<1>::fits(boardMask, numPieces)) {
+      BitboardSolver<1> solver;
+      runBitboard(solver);
+    }
+    else {
+      BitboardSolver<2> solver;
+      runBitboard(solver);
+    }
+  }
+  else if (engine == SearchEngine::DancingCells) {
+    DancingCells solver;
+    configureEngine(solver);
+    runEngine(solver);
+  }
+  else if (engine == SearchEngine::MeetInTheMiddle) {
+    MeetInTheMiddle solver;
+    try {
+      configureEngine(solver);
+    }
+    catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    solver.setThreads(numThreads);
+    std::cout << "Meet in the middle: " << solver.bandCells() << " cells along the cut\n";
+    runEngine(solver);
+    std::cout << "Meet in the middle: " << solver.leftGroups() << " left groups\n";
+  }
+  else if (engine == SearchEngine::Frontier) {
+    FrontierCounter solver;
+    try {
+      configureEngine(solver);
+    }
+    catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    std::cout << "Frontier: sweeping with a window of " << solver.windowRanks() << " cells\n";
+    runEngine(solver);
+    std::cout << "Frontier: " << solver.exactCount().toString() << " solutions, at most "
+              << solver.peakStates() << " states per step\n";
+  }
+  else {
+    DLX dlx;
+    configureEngine(dlx);
+    dlx.p_searchStats = &g_searchStats;
+
+    if (estimateProbes > 0) {
+      std::mt19937_64 rng(seed != 0 ? seed : std::random_device{}());
+      g_treeEstimator.run(dlx, rng, estimateProbes, &g_stopFlag);
+      printEstimate(std::cout, g_treeEstimator.estimate());
+    }
+
+    // Background probes run on their own copy of the matrix
+    std::atomic<bool> estimatorStop{false};
+    std::thread estimatorThread;
+    if (backgroundEstimate && !estimateOnly) {
+      estimatorThread = std::thread([&estimatorStop, &seed, probeDLX = dlx]() mutable {
+        std::mt19937_64 rng(seed != 0 ? seed + 1 : std::random_device{}());
+        g_treeEstimator.run(probeDLX, rng, 0, &estimatorStop);
+      });
+    }
+
+    if (estimateOnly) {
+      // Nothing to search
+    }
+    else if (firstSolution) {
+      if (numThreads > 1) {
+        std::cerr << "Note: --first-solution searches on one thread.\n";
+      }
+      const FirstSolution fs = findFirstSolution(dlx, seed != 0 ? seed : std::random_device{}(),
+                                                 restartNodes, &g_stopFlag);
+      g_nodesVisited.store(fs.nodes);
+      if (fs.found) {
+        std::cout << "First solution after " << fs.nodes << " nodes and " << fs.restarts << " restarts\n";
+        g_solutionsFound.fetch_add(1);
+        handleSolution(fs.rows);
+      }
+      else if (fs.exhausted) {
+        std::cout << "No solution exists (run " << fs.restarts + 1 << " searched the whole tree, "
+                  << fs.nodes << " nodes in all runs)\n";
+      }
+      else {
+        std::cout << "Stopped after " << fs.nodes << " nodes and " << fs.restarts << " restarts\n";
+      }
+    }
+    else if (!shardSpec.empty()) {
+      if (numThreads > 1) {
+        std::cerr << "Note: a shard searches on one thread; run more shards instead.\n";
+      }
+      // Every shard must make the same split, so the probes get a fixed seed
+      const uint64_t shardSeed = seed != 0 ? seed : 1;
+      const std::vector<std::vector<int>> prefixes = enumeratePrefixes(dlx, shardDepth);
+      const std::vector<double> weights = shardProbes > 0
+        ? estimatePrefixWeights(dlx, prefixes, shardProbes, shardSeed)
+        : std::vector<double>{};
+      const std::vector<int> owner = assignShards(weights, prefixes.size(), numShards);
+
+      ShardResult result;
+      result.fingerprint = puzzleFingerprint(placements, boardMask, boardWidth, boardHeight,
+                                             static_cast<int>(heuristic), optionalPieces);
+      result.config = "depth=" + std::to_string(shardDepth) + ",probes=" + std::to_string(shardProbes) +
+                      ",seed=" + std::to_string(shardProbes > 0 ? shardSeed : 0);
+      result.shard = shardIndex;
+      result.numShards = numShards;
+      result.split = splitFingerprint(prefixes, owner);
+      result.totalPrefixes = prefixes.size();
+      result.dedup = dedupSolutions && !countOnly;
+
+      constexpr uint64_t kSliceNodes = 1 << 16;
+      for (size_t k = 0; k < prefixes.size() && !g_stopFlag.load(); ++k) {
+        if (owner[k] != shardIndex) continue;
+        for (int row : prefixes[k]) dlx.selectRow(row);
+        dlx.beginSearch();
+        while (countOnly ? dlx.countStep(kSliceNodes) : dlx.step(kSliceNodes)) {
+        }
+        if (countOnly) solutionCounter += dlx.solutionCount();
+        for (auto it = prefixes[k].rbegin(); it != prefixes[k].rend(); ++it) dlx.unselectRow(*it);
+        ++result.prefixes;
+      }
+
+      result.finished = !g_stopFlag.load();
+      result.nodesVisited = g_nodesVisited.load();
+      result.solutionsFound = g_solutionsFound.load();
+      result.solutionsReported = solutionCounter;
+      if (result.dedup) result.uniqueForms = ::uniqueSolutions.fingerprints();
+      try {
+        saveShardResult(result, shardFile);
+      }
+      catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        ok = false;
+      }
+      std::cout << "Shard " << shardIndex << "/" << numShards << ": searched " << result.prefixes << " of "
+                << prefixes.size() << " prefixes, results in " << shardFile << "\n";
+    }
+    else if (!batchFile.empty()) {
+      const auto results = solveBatch(dlx, boardMask, batchMasks, numThreads,
+        [&](size_t i, const BatchResult& r) {
+          std::cout << "Mask " << i + 1 << " (" << batchMasks[i].label << "): " << r.solutions
+                    << " solutions, " << r.nodes << " nodes, " << std::fixed << std::setprecision(2)
+                    << r.seconds << "s" << std::defaultfloat << (r.finished ? "" : " (stopped)") << "\n";
+        });
+      for (const BatchResult& r : results) {
+        solutionCounter += r.solutions;
+      }
+    }
+    else if (numThreads > 1) {
+      ParallelSearch parallelSearch(dlx, numThreads, splitDepth);
+      parallelSearch.handleSolution = handleSolution;
+      parallelSearch.setCountOnly(countOnly);
+      parallelSearch.run();
+
+      if (countOnly) {
+        for (const auto& [r, count] : parallelSearch.branchCounts()) {
+          printBranchCount(r, count);
+        }
+        solutionCounter = parallelSearch.totalCount();
+      }
+    }
+    else if (checkpointing) {
+      ok = runCheckpointed(dlx);
+    }
+    else {
+      runEngine(dlx);
+    }
+
+    if (estimatorThread.joinable()) {
+      estimatorStop.store(true);
+      estimatorThread.join();
+      printEstimate(std::cout, g_treeEstimator.estimate());
+    }
+  }
   // dlx.searchWithDebug();
   // debugDLX(dlx, placements, boardWidth, boardHeight);
 
@@ -653,8 +1373,38 @@ int main(int argc, char* argv[])
     reporterThread.join();
   }
 
-  std::cout << "Search finished. Total nodes visited: " << g_nodesVisited.load()
-            << ", solutions found: " << solutionCounter << "\n";
+  if (!estimateOnly) {
+    std::cout << "Search finished. Total nodes visited: " << g_nodesVisited.load()
+              << ", solutions found: " << solutionCounter << "\n";
+  }
+  if (dedupSolutions && !countOnly) {
+    std::cout << "Unique-solution set: " << ::uniqueSolutions.size() << " fingerprints in "
+              << (::uniqueSolutions.memoryBytes() + 1023) / 1024 << " KB";
+    if (::uniqueSolutions.verifying()) {
+      std::cout << ", " << ::uniqueSolutions.collisions() << " fingerprint collisions";
+    }
+    std::cout << "\n";
+  }
+
+  if (expandIdentical && optionalPieces) {
+    std::cout << "Note: with --optional-pieces a tiling stands for a varying number of labeled solutions; "
+                 "no expanded count.\n";
+  }
+  else if (expandIdentical && !estimateOnly) {
+    uint64_t expanded = 0;
+    if (__builtin_mul_overflow(static_cast<uint64_t>(solutionCounter), copyPermutations, &expanded)) {
+      std::cout << "Expanded count (identical pieces told apart): " << solutionCounter
+                << " x " << copyPermutations << " (exceeds 64 bits)\n";
+    }
+    else {
+      std::cout << "Expanded count (identical pieces told apart): " << expanded << "\n";
+    }
+  }
+
+  if (printStats) {
+    std::cout << "Per-depth statistics:\n";
+    SearchStats::print(std::cout, g_searchStats.snapshot());
+  }
 
   if (saveVideo)
   {
@@ -667,5 +1417,5 @@ int main(int argc, char* argv[])
     createAndSaveVideo(videoFilename.c_str(), videoWidth, videoHeight, videoFPS, videoFrames);
   }
 
-  return 0;
+  return ok ? 0 : 1;
 }
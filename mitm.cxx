@@ -0,0 +1,376 @@
+#include "mitm.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+void MeetInTheMiddle::setup(const std::vector<Placement>& placements,
+                            const std::vector<bool>& boardMask,
+                            int boardWidth, int boardHeight,
+                            int numPieces, bool optionalPieces)
+{
+  if (numPieces > kMaxPieces) {
+    throw std::runtime_error("The mitm engine supports at most " + std::to_string(kMaxPieces) + " pieces.");
+  }
+  m_numPieces = numPieces;
+  m_allPieces = numPieces == 64 ? ~uint64_t{0} : (uint64_t{1} << numPieces) - 1;
+  m_optionalPieces = optionalPieces;
+
+  // Rank the usable cells along the long axis, then across it
+  const bool alongX = boardWidth >= boardHeight;
+  auto major = [&](int cell) { return alongX ? cell % boardWidth : cell / boardWidth; };
+  auto minor = [&](int cell) { return alongX ? cell / boardWidth : cell % boardWidth; };
+
+  std::vector<int> cells;
+  for (int i = 0; i < boardWidth * boardHeight; ++i) {
+    if (boardMask[i]) cells.push_back(i);
+  }
+  std::sort(cells.begin(), cells.end(), [&](int a, int b) {
+    return std::make_pair(major(a), minor(a)) < std::make_pair(major(b), minor(b));
+  });
+  m_numCells = static_cast<int>(cells.size());
+  std::vector<int> rankOf(boardMask.size(), -1);
+  for (int r = 0; r < m_numCells; ++r) rankOf[static_cast<size_t>(cells[r])] = r;
+
+  std::vector<size_t> valid;
+  int reach = 0;
+  for (size_t i = 0; i < placements.size(); ++i) {
+    const Placement& pl = placements[i];
+    if (std::any_of(pl.cells.begin(), pl.cells.end(), [&](int c) { return !boardMask[c]; })) continue;
+    valid.push_back(i);
+    const auto [lo, hi] = std::minmax_element(pl.cells.begin(), pl.cells.end(),
+                                              [&](int a, int b) { return major(a) < major(b); });
+    reach = std::max(reach, major(*hi) - major(*lo));
+  }
+
+  // Cut at the median cell; left placements reach at most 'reach' columns past it
+  const int cutMajor = m_numCells > 0 ? major(cells[static_cast<size_t>(m_numCells / 2)]) : 0;
+  m_cutRank = 0;
+  while (m_cutRank < m_numCells && major(cells[m_cutRank]) < cutMajor) ++m_cutRank;
+
+  std::vector<int> bandBit(static_cast<size_t>(m_numCells), -1);
+  m_bandRank.clear();
+  for (int r = m_cutRank; r < m_numCells && major(cells[r]) < cutMajor + reach; ++r) {
+    bandBit[r] = static_cast<int>(m_bandRank.size());
+    m_bandRank.push_back(r);
+  }
+  m_bandCells = static_cast<int>(m_bandRank.size());
+  if (m_bandCells > kMaxBandCells) {
+    throw std::runtime_error("The mitm engine supports at most " + std::to_string(kMaxBandCells) +
+                             " cells along the cut, this board needs " + std::to_string(m_bandCells) + ".");
+  }
+
+  m_candidates.clear();
+  m_byFirst.assign(static_cast<size_t>(m_numCells), {});
+  for (size_t i : valid) {
+    const Placement& pl = placements[i];
+    Candidate c;
+    c.rowID = static_cast<int>(i);
+    c.piece = uint64_t{1} << pl.pieceID;
+    c.needs = 0;
+    c.group = c.piece;
+    for (int cell : pl.cells) c.ranks.push_back(rankOf[static_cast<size_t>(cell)]);
+    std::sort(c.ranks.begin(), c.ranks.end());
+    if (c.ranks.front() < m_cutRank) {
+      for (int r : c.ranks) {
+        if (r >= m_cutRank) c.band.set(bandBit[r]);
+      }
+    }
+    m_byFirst[static_cast<size_t>(c.ranks.front())].push_back(static_cast<int>(m_candidates.size()));
+    m_candidates.push_back(std::move(c));
+  }
+
+  m_needs.assign(static_cast<size_t>(numPieces), 0);
+  m_copyLabels = CopyLabels();
+}
+
+void MeetInTheMiddle::setIdenticalPieces(const std::vector<Placement>& placements, const std::vector<int>& previousCopy)
+{
+  std::vector<uint64_t> group(static_cast<size_t>(m_numPieces), 0);
+  for (int p = 0; p < m_numPieces; ++p) {
+    const int prev = previousCopy[static_cast<size_t>(p)];
+    m_needs[static_cast<size_t>(p)] = prev < 0 ? 0 : uint64_t{1} << prev;
+    // Copies come after the piece they copy
+    group[static_cast<size_t>(p)] = (prev < 0 ? 0 : group[static_cast<size_t>(prev)]) | (uint64_t{1} << p);
+  }
+  // Every copy gets the bits of the whole chain
+  for (int p = m_numPieces - 1; p >= 0; --p) {
+    const int prev = previousCopy[static_cast<size_t>(p)];
+    if (prev >= 0) group[static_cast<size_t>(prev)] = group[static_cast<size_t>(p)];
+  }
+  for (Candidate& c : m_candidates) {
+    const int piece = lowestSetBit(c.piece);
+    c.needs = m_needs[static_cast<size_t>(piece)];
+    c.group = group[static_cast<size_t>(piece)];
+  }
+
+  m_copyLabels.setup(placements, previousCopy);
+}
+
+void MeetInTheMiddle::search()
+{
+  enumerateLeft(false, false);
+  joinRight(false, nullptr);
+}
+
+uint64_t MeetInTheMiddle::countSolutions()
+{
+  enumerateLeft(true, false);
+  return joinRight(true, nullptr);
+}
+
+uint64_t MeetInTheMiddle::countSolutionsPerBranch(const std::function<void(int, uint64_t)>& onBranch)
+{
+  enumerateLeft(true, true);
+  std::map<int, uint64_t> branchCounts;
+  const uint64_t total = joinRight(true, &branchCounts);
+  if (!onBranch) return total;
+
+  if (m_cutRank == 0) {
+    onBranch(-1, total);
+    return total;
+  }
+  for (int ci : m_byFirst[0]) {
+    const Candidate& c = m_candidates[static_cast<size_t>(ci)];
+    if (c.needs) continue;
+    const auto it = branchCounts.find(c.rowID);
+    onBranch(c.rowID, it == branchCounts.end() ? 0 : it->second);
+  }
+  return total;
+}
+
+void MeetInTheMiddle::flushNodes(Half& h)
+{
+  if (p_nodesVisited) p_nodesVisited->fetch_add(h.nodes, std::memory_order_relaxed);
+  h.nodes = 0;
+}
+
+bool MeetInTheMiddle::fits(const Half& h, const Candidate& c) const
+{
+  for (int r : c.ranks) {
+    if (h.occupied[static_cast<size_t>(r)]) return false;
+  }
+  return true;
+}
+
+void MeetInTheMiddle::place(Half& h, const Candidate& c)
+{
+  for (int r : c.ranks) h.occupied[static_cast<size_t>(r)] = 1;
+  h.used |= c.piece;
+  h.band = h.band | c.band;
+  h.rows.push_back(c.rowID);
+}
+
+void MeetInTheMiddle::unplace(Half& h, const Candidate& c)
+{
+  for (int r : c.ranks) h.occupied[static_cast<size_t>(r)] = 0;
+  h.used &= ~c.piece;
+  // Placements never overlap, so their band bits can be cleared again
+  for (int k = 0; k < kMaxBandCells / 64; ++k) h.band.w[k] &= ~c.band.w[k];
+  h.rows.pop_back();
+}
+
+// Left copies are used from the first one on: copy k needs copy k-1
+template <typename Record>
+void MeetInTheMiddle::searchLeft(Half& h, int rank, const Record& record)
+{
+  if (stopped()) return;
+  ++h.nodes;
+  while (rank < m_cutRank && h.occupied[static_cast<size_t>(rank)]) ++rank;
+  if (rank == m_cutRank) {
+    record(h);
+    return;
+  }
+  for (int ci : m_byFirst[static_cast<size_t>(rank)]) {
+    const Candidate& c = m_candidates[static_cast<size_t>(ci)];
+    if ((c.piece & h.used) || (c.needs & ~h.used) || !fits(h, c)) continue;
+    place(h, c);
+    searchLeft(h, rank + 1, record);
+    unplace(h, c);
+  }
+}
+
+// Right copies continue where the left ones stopped, which is only known at
+// the join: the first copy used may be any, the following ones are consecutive
+template <typename Record>
+void MeetInTheMiddle::searchRight(Half& h, int rank, const Record& record)
+{
+  if (stopped()) return;
+  ++h.nodes;
+  while (rank < m_numCells && h.occupied[static_cast<size_t>(rank)]) ++rank;
+  if (rank == m_numCells) {
+    record(h);
+    return;
+  }
+  for (int ci : m_byFirst[static_cast<size_t>(rank)]) {
+    const Candidate& c = m_candidates[static_cast<size_t>(ci)];
+    if (c.piece & h.used) continue;
+    if ((c.group & h.used) && (!c.needs || (c.needs & ~h.used))) continue;
+    if (!fits(h, c)) continue;
+    place(h, c);
+    searchRight(h, rank + 1, record);
+    unplace(h, c);
+  }
+}
+
+template <typename Task>
+void MeetInTheMiddle::runParallel(size_t numTasks, const Task& task)
+{
+  const int numThreads = static_cast<int>(std::min<size_t>(static_cast<size_t>(m_numThreads), numTasks));
+  if (numThreads <= 1) {
+    for (size_t k = 0; k < numTasks && !stopped(); ++k) task(0, k);
+    return;
+  }
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t k = next++; k < numTasks && !stopped(); k = next++) task(t, k);
+    });
+  }
+  for (std::thread& th : threads) th.join();
+}
+
+void MeetInTheMiddle::enumerateLeft(bool countOnly, bool perBranch)
+{
+  using GroupKey = std::pair<uint64_t, int>;  // pieces, first row
+  using LeftMap = std::unordered_map<Profile, std::map<GroupKey, Group>, ProfileHash>;
+
+  const int numThreads = m_numThreads;
+  std::vector<LeftMap> maps(static_cast<size_t>(numThreads));
+  std::vector<Half> halves(static_cast<size_t>(numThreads));
+  for (Half& h : halves) h.occupied.assign(static_cast<size_t>(m_numCells), 0);
+
+  // The first cell's placements are the tasks; a board without a left half
+  // has the empty tiling only
+  const size_t numTasks = m_cutRank > 0 ? m_byFirst[0].size() : 1;
+  runParallel(numTasks, [&](int t, size_t k) {
+    Half& h = halves[static_cast<size_t>(t)];
+    LeftMap& map = maps[static_cast<size_t>(t)];
+    auto record = [&](const Half& leaf) {
+      const GroupKey key(leaf.used, perBranch ? leaf.rows.front() : -1);
+      Group& g = map[leaf.band][key];
+      g.pieces = key.first;
+      g.firstRow = key.second;
+      ++g.count;
+      if (!countOnly) g.tilings.push_back(leaf.rows);
+    };
+    if (m_cutRank == 0) {
+      record(h);
+      return;
+    }
+    const Candidate& c = m_candidates[static_cast<size_t>(m_byFirst[0][k])];
+    if (c.needs) return;
+    place(h, c);
+    searchLeft(h, 1, record);
+    unplace(h, c);
+    flushNodes(h);
+  });
+
+  // Merge the threads' tables and lay them out by profile
+  LeftMap& merged = maps[0];
+  for (size_t t = 1; t < maps.size(); ++t) {
+    for (auto& [profile, groups] : maps[t]) {
+      auto& into = merged[profile];
+      for (auto& [key, g] : groups) {
+        Group& dst = into[key];
+        dst.pieces = g.pieces;
+        dst.firstRow = g.firstRow;
+        dst.count += g.count;
+        for (auto& tiling : g.tilings) dst.tilings.push_back(std::move(tiling));
+      }
+    }
+    maps[t].clear();
+  }
+
+  m_profiles.clear();
+  m_leftGroups.clear();
+  m_leftGroupCount = 0;
+  for (auto& [profile, groups] : merged) {
+    m_profiles.push_back(profile);
+    m_leftGroups.emplace_back();
+    for (auto& entry : groups) m_leftGroups.back().push_back(std::move(entry.second));
+    m_leftGroupCount += groups.size();
+  }
+}
+
+uint64_t MeetInTheMiddle::joinRight(bool countOnly, std::map<int, uint64_t>* branchCounts)
+{
+  const int numThreads = m_numThreads;
+  std::vector<Half> halves(static_cast<size_t>(numThreads));
+  std::vector<uint64_t> totals(static_cast<size_t>(numThreads), 0);
+  std::vector<std::map<int, uint64_t>> branches(static_cast<size_t>(numThreads));
+
+  runParallel(m_profiles.size(), [&](int t, size_t k) {
+    Half& h = halves[static_cast<size_t>(t)];
+    h.occupied.assign(static_cast<size_t>(m_numCells), 0);
+    for (int b = 0; b < m_bandCells; ++b) {
+      if (m_profiles[k].test(b)) h.occupied[static_cast<size_t>(m_bandRank[static_cast<size_t>(b)])] = 1;
+    }
+
+    std::unordered_map<uint64_t, Group> right;
+    searchRight(h, m_cutRank, [&](const Half& leaf) {
+      Group& g = right[leaf.used];
+      g.pieces = leaf.used;
+      ++g.count;
+      if (!countOnly) g.tilings.push_back(leaf.rows);
+    });
+    flushNodes(h);
+
+    auto join = [&](const Group& left, const Group& r) {
+      const uint64_t n = left.count * r.count;
+      totals[static_cast<size_t>(t)] += n;
+      if (countOnly) {
+        if (p_solutionsFound) p_solutionsFound->fetch_add(n);
+        if (branchCounts) branches[static_cast<size_t>(t)][left.firstRow] += n;
+        return;
+      }
+      for (const std::vector<int>& lt : left.tilings) {
+        for (const std::vector<int>& rt : r.tilings) {
+          if (stopped()) return;
+          std::vector<int> rows = lt;
+          rows.insert(rows.end(), rt.begin(), rt.end());
+          rows = m_copyLabels.canonical(std::move(rows));
+          std::lock_guard<std::mutex> lock(m_solutionMutex);
+          if (handleSolution) handleSolution(rows);
+          if (p_solutionsFound) p_solutionsFound->fetch_add(1);
+        }
+      }
+    };
+
+    for (const Group& left : m_leftGroups[k]) {
+      if (!m_optionalPieces) {
+        const auto it = right.find(m_allPieces & ~left.pieces);
+        if (it != right.end()) join(left, it->second);
+        continue;
+      }
+      for (const auto& [pieces, r] : right) {
+        if (!(pieces & left.pieces) && consistentCopies(pieces | left.pieces)) join(left, r);
+      }
+    }
+  });
+
+  uint64_t total = 0;
+  for (size_t t = 0; t < totals.size(); ++t) {
+    total += totals[t];
+    if (branchCounts) {
+      for (const auto& [row, n] : branches[t]) (*branchCounts)[row] += n;
+    }
+  }
+
+  // The left tilings are only needed for one join
+  m_profiles.clear();
+  m_leftGroups.clear();
+  return total;
+}
+
+// With optional pieces the copies in use must be the first ones of their shape
+bool MeetInTheMiddle::consistentCopies(uint64_t pieces) const
+{
+  for (uint64_t bits = pieces; bits; bits &= bits - 1) {
+    if (m_needs[static_cast<size_t>(lowestSetBit(bits))] & ~pieces) return false;
+  }
+  return true;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "bitboard.h"
+#include "copy_order.h"
+#include "dlx.h"
+#include "shapes.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Meet-in-the-middle exact cover. The board is cut across its long axis.
+// Placements whose first column (along that axis) lies left of the cut belong
+// to the left half and may stick out over the cut into a band of cells; all
+// others belong to the right half. The left half is enumerated once and its
+// partial tilings are grouped by (pieces used, band cells covered). The right
+// half is then solved once per distinct band profile, on as many threads as
+// given, and joined with the left groups of that profile through a hash on
+// the pieces used. Memory grows with the number of left partial tilings.
+//
+// Identical pieces: each half numbers its copies in the order it fills the
+// cells (left copies are always the first ones), and reported solutions are
+// relabeled to the order DLX uses, so solution rows are the same as for DLX.
+class MeetInTheMiddle
+{
+public:
+  static constexpr int kMaxBandCells = 128;
+  static constexpr int kMaxPieces = 64;
+
+  // external control/monitoring hooks
+  std::function<void(const std::vector<int>&)> handleSolution;
+  std::atomic<uint64_t>* p_nodesVisited = nullptr;
+  std::atomic<uint64_t>* p_solutionsFound = nullptr;
+  std::atomic<bool>* p_stopFlag = nullptr;
+
+  // Throws std::runtime_error if there are more than kMaxPieces pieces or the
+  // band along the cut has more than kMaxBandCells cells
+  void setup(const std::vector<Placement>& placements,
+             const std::vector<bool>& boardMask,
+             int boardWidth, int boardHeight, int numPieces,
+             bool optionalPieces = false);
+
+  // Both halves always fill their lowest empty cell
+  void setHeuristic(HeuristicMode) {}
+
+  void setIdenticalPieces(const std::vector<Placement>& placements, const std::vector<int>& previousCopy);
+
+  void setThreads(int numThreads) { m_numThreads = numThreads > 1 ? numThreads : 1; }
+
+  void search();
+  uint64_t countSolutions();
+  // Branches are the placements that cover the first cell of the left half
+  uint64_t countSolutionsPerBranch(const std::function<void(int, uint64_t)>& onBranch);
+
+  int bandCells() const { return m_bandCells; }
+  size_t leftGroups() const { return m_leftGroupCount; }
+  size_t profiles() const { return m_profiles.size(); }
+
+private:
+  using Profile = Bits<kMaxBandCells / 64>;
+
+  struct ProfileHash
+  {
+    size_t operator()(const Profile& p) const {
+      uint64_t h = p.w[0] * 0x9E3779B97F4A7C15ull;
+      h ^= (p.w[1] + (h >> 29)) * 0xBF58476D1CE4E5B9ull;
+      return static_cast<size_t>(h ^ (h >> 32));
+    }
+  };
+
+  struct Candidate
+  {
+    int rowID;
+    uint64_t piece;  // bit of the piece
+    uint64_t needs;  // copy bit that must already be used in the same half
+    uint64_t group;  // bits of all copies of the piece
+    Profile band;    // band cells covered (left placements only)
+    std::vector<int> ranks;
+  };
+
+  // Partial tilings of one half with the same pieces (and, in count mode,
+  // the same first placement)
+  struct Group
+  {
+    uint64_t pieces = 0;
+    int firstRow = -1;
+    uint64_t count = 0;
+    std::vector<std::vector<int>> tilings;  // only when enumerating
+  };
+
+  // Search state of one thread
+  struct Half
+  {
+    std::vector<uint8_t> occupied;  // by rank
+    std::vector<int> rows;
+    uint64_t used = 0;
+    Profile band;
+    uint64_t nodes = 0;
+  };
+
+  int m_numThreads = 1;
+  bool m_optionalPieces = false;
+  int m_numPieces = 0;
+  uint64_t m_allPieces = 0;
+
+  // Usable cells are ranked along the long axis; ranks below m_cutRank are
+  // left of the cut
+  int m_numCells = 0;
+  int m_cutRank = 0;
+  int m_bandCells = 0;
+  std::vector<int> m_bandRank;  // rank of every band bit
+
+  std::vector<Candidate> m_candidates;
+  std::vector<std::vector<int>> m_byFirst;  // candidates by their lowest rank
+  std::vector<uint64_t> m_needs;            // by piece
+
+  CopyLabels m_copyLabels;
+
+  // Left groups by band profile
+  std::vector<Profile> m_profiles;
+  std::vector<std::vector<Group>> m_leftGroups;
+  size_t m_leftGroupCount = 0;
+
+  std::mutex m_solutionMutex;
+
+  bool stopped() const { return p_stopFlag && p_stopFlag->load(std::memory_order_relaxed); }
+  void flushNodes(Half& h);
+
+  bool fits(const Half& h, const Candidate& c) const;
+  void place(Half& h, const Candidate& c);
+  void unplace(Half& h, const Candidate& c);
+
+  template <typename Record>
+  void searchLeft(Half& h, int rank, const Record& record);
+  template <typename Record>
+  void searchRight(Half& h, int rank, const Record& record);
+
+  void enumerateLeft(bool countOnly, bool perBranch);
+  // Solve the right half for every profile and join; returns the solution
+  // count and adds per-branch counts to branchCounts (by row ID) if given
+  uint64_t joinRight(bool countOnly, std::map<int, uint64_t>* branchCounts);
+
+  bool consistentCopies(uint64_t pieces) const;
+
+  template <typename Task>
+  void runParallel(size_t numTasks, const Task& task);
+};
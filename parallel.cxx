@@ -0,0 +1,179 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+// Nodes searched between checks for idle workers
+constexpr uint64_t kSliceNodes = 4096;
+}
+
+ParallelSearch::ParallelSearch(const DLX& prototype, int numThreads, int splitDepth)
+  : m_prototype(prototype),
+    m_numThreads(std::max(1, numThreads)),
+    m_splitDepth(std::max(0, splitDepth))
+{
+  for (int i = 0; i < m_numThreads; ++i) {
+    m_queues.emplace_back(std::make_unique<WorkQueue>());
+  }
+}
+
+void ParallelSearch::setCountOnly(bool countOnly)
+{
+  m_countOnly = countOnly;
+}
+
+uint64_t ParallelSearch::totalCount() const
+{
+  uint64_t total = 0;
+  for (const auto& [row, count] : m_branchCounts) {
+    total += count;
+  }
+  return total;
+}
+
+void ParallelSearch::run()
+{
+  // Per-branch counts need the first level split into separate prefixes
+  if (m_countOnly) {
+    m_splitDepth = std::max(1, m_splitDepth);
+  }
+
+  pushTask(0, {});
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < m_numThreads; ++i) {
+    workers.emplace_back(&ParallelSearch::workerLoop, this, i);
+  }
+  for (auto& t : workers) {
+    t.join();
+  }
+}
+
+void ParallelSearch::workerLoop(int id)
+{
+  DLX dlx = m_prototype;
+  dlx.handleSolution = [this](const std::vector<int>& rows) {
+    std::lock_guard<std::mutex> lock(m_solutionMutex);
+    if (handleSolution) handleSolution(rows);
+  };
+
+  std::vector<int> prefix;
+  bool idle = false;
+
+  while (true) {
+    if (dlx.p_stopFlag && dlx.p_stopFlag->load(std::memory_order_relaxed)) break;
+
+    if (popTask(id, prefix)) {
+      if (idle) {
+        m_idleWorkers.fetch_sub(1);
+        idle = false;
+      }
+      runTask(dlx, id, prefix);
+      m_pendingTasks.fetch_sub(1);
+      continue;
+    }
+
+    if (m_pendingTasks.load() == 0) break;
+    if (!idle) {
+      m_idleWorkers.fetch_add(1);
+      idle = true;
+    }
+    std::this_thread::yield();
+  }
+
+  if (idle) {
+    m_idleWorkers.fetch_sub(1);
+  }
+}
+
+void ParallelSearch::runTask(DLX& dlx, int id, const std::vector<int>& prefix)
+{
+  // Donated prefixes are not checked against the copy order of identical
+  // pieces; one that breaks it has an empty subtree
+  for (size_t i = 0; i < prefix.size(); ++i) {
+    if (!dlx.rowAllowed(prefix[i])) {
+      for (size_t k = i; k > 0; --k) dlx.unselectRow(prefix[k - 1]);
+      return;
+    }
+    dlx.selectRow(prefix[i]);
+  }
+
+  if (static_cast<int>(prefix.size()) < m_splitDepth && !dlx.isSolved()) {
+    // Expand one level; children are pushed in reverse so they pop in order
+    if (dlx.p_nodesVisited) dlx.p_nodesVisited->fetch_add(1);
+    const std::vector<int> rows = dlx.branchRows();
+    if (m_countOnly && prefix.empty()) {
+      // List every first-level branch, including those that end up empty
+      std::lock_guard<std::mutex> lock(m_solutionMutex);
+      for (int row : rows) {
+        m_branchCounts[row] += 0;
+      }
+    }
+    for (auto it = rows.rbegin(); it != rows.rend(); ++it) {
+      std::vector<int> child = prefix;
+      child.push_back(*it);
+      pushTask(id, std::move(child));
+    }
+  }
+  else {
+    dlx.beginSearch();
+    while (m_countOnly ? dlx.countStep(kSliceNodes) : dlx.step(kSliceNodes)) {
+      if (m_idleWorkers.load(std::memory_order_relaxed) > 0 && queueEmpty(id)) {
+        for (auto& donated : dlx.donateWork()) {
+          pushTask(id, std::move(donated));
+        }
+      }
+    }
+
+    if (m_countOnly) {
+      std::lock_guard<std::mutex> lock(m_solutionMutex);
+      m_branchCounts[prefix.empty() ? -1 : prefix.front()] += dlx.solutionCount();
+    }
+  }
+
+  for (auto it = prefix.rbegin(); it != prefix.rend(); ++it) {
+    dlx.unselectRow(*it);
+  }
+}
+
+void ParallelSearch::pushTask(int id, std::vector<int> prefix)
+{
+  m_pendingTasks.fetch_add(1);
+  WorkQueue& q = *m_queues[static_cast<size_t>(id)];
+  std::lock_guard<std::mutex> lock(q.mutex);
+  q.prefixes.push_back(std::move(prefix));
+}
+
+bool ParallelSearch::popTask(int id, std::vector<int>& prefix)
+{
+  {
+    WorkQueue& own = *m_queues[static_cast<size_t>(id)];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.prefixes.empty()) {
+      prefix = std::move(own.prefixes.back());
+      own.prefixes.pop_back();
+      return true;
+    }
+  }
+
+  // Steal the oldest (shallowest, usually largest) prefix from another worker
+  for (int k = 1; k < m_numThreads; ++k) {
+    WorkQueue& victim = *m_queues[static_cast<size_t>((id + k) % m_numThreads)];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.prefixes.empty()) {
+      prefix = std::move(victim.prefixes.front());
+      victim.prefixes.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParallelSearch::queueEmpty(int id)
+{
+  WorkQueue& q = *m_queues[static_cast<size_t>(id)];
+  std::lock_guard<std::mutex> lock(q.mutex);
+  return q.prefixes.empty();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "dlx.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Multithreaded DLX search with work stealing.
+// Work items are row prefixes (paths from the root). Each worker owns a copy of
+// the DLX matrix and a deque of prefixes: it pops from the back of its own deque
+// and steals from the front of the others. Prefixes shorter than splitDepth are
+// expanded by one level into child prefixes; longer ones are searched with the
+// resumable engine, which donates untried sibling rows whenever a worker is idle.
+class ParallelSearch
+{
+public:
+  // Called for every solution, serialized across workers
+  std::function<void(const std::vector<int>&)> handleSolution;
+
+  ParallelSearch(const DLX& prototype, int numThreads, int splitDepth);
+
+  // Count solutions with DLX::countStep() instead of reporting them
+  void setCountOnly(bool countOnly);
+
+  void run();
+
+  // Count-only results: total, and per row of the first branching column
+  // (key -1 if the root itself is a solution)
+  uint64_t totalCount() const;
+  const std::map<int, uint64_t>& branchCounts() const { return m_branchCounts; }
+
+private:
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    std::deque<std::vector<int>> prefixes;
+  };
+
+  const DLX& m_prototype;
+  int m_numThreads;
+  int m_splitDepth;
+  bool m_countOnly = false;
+
+  std::vector<std::unique_ptr<WorkQueue>> m_queues;
+  std::atomic<int64_t> m_pendingTasks{0}; // pushed but not yet finished
+  std::atomic<int> m_idleWorkers{0};
+  std::mutex m_solutionMutex;
+  std::map<int, uint64_t> m_branchCounts; // guarded by m_solutionMutex
+
+  void workerLoop(int id);
+  void runTask(DLX& dlx, int id, const std::vector<int>& prefix);
+
+  void pushTask(int id, std::vector<int> prefix);
+  bool popTask(int id, std::vector<int>& prefix);
+  bool queueEmpty(int id);
+};
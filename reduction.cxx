@@ -0,0 +1,224 @@
+#include "reduction.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+// Smallest area and gcd of a set of piece areas; gcd 0 means the set is empty
+struct AreaBound
+{
+  int minArea = std::numeric_limits<int>::max();
+  int areaGcd = 0;
+
+  void add(int area) {
+    minArea = std::min(minArea, area);
+    areaGcd = std::gcd(areaGcd, area);
+  }
+  bool fits(int area) const {
+    return areaGcd != 0 && area >= minArea && area % areaGcd == 0;
+  }
+};
+}
+
+ReductionStats reducePlacements(std::vector<Placement>& placements,
+                                const std::vector<bool>& mask,
+                                int W, int H, int numPieces, bool optionalPieces)
+{
+  ReductionStats stats;
+  stats.inputPlacements = placements.size();
+
+  const size_t numCells = static_cast<size_t>(W) * static_cast<size_t>(H);
+  std::vector<bool> alive(placements.size(), true);
+  std::vector<bool> forced(placements.size(), false);
+  std::vector<bool> occupied(numCells, false);  // cells of forced placements
+  std::vector<bool> pieceForced(static_cast<size_t>(numPieces), false);
+
+  std::vector<int> pieceArea(static_cast<size_t>(numPieces), 0);
+  for (const Placement& pl : placements) {
+    pieceArea[static_cast<size_t>(pl.pieceID)] = static_cast<int>(pl.cells.size());
+  }
+
+  auto isFree = [&](int cell) { return mask[static_cast<size_t>(cell)] && !occupied[static_cast<size_t>(cell)]; };
+
+  // Flood fill stamps: every fill and every set of blocked cells gets its own
+  // stamp, so nothing has to be cleared between fills
+  std::vector<uint32_t> stamp(numCells, 0);
+  uint32_t nextStamp = 0;
+  std::vector<int> stack;
+
+  // Area of the free region around 'start', not crossing cells stamped
+  // 'blockStamp'
+  auto fillArea = [&](int start, uint32_t fillStamp, uint32_t blockStamp) {
+    int area = 0;
+    stack.assign(1, start);
+    stamp[static_cast<size_t>(start)] = fillStamp;
+    while (!stack.empty()) {
+      const int cell = stack.back();
+      stack.pop_back();
+      ++area;
+      const int x = cell % W, y = cell / W;
+      const int next[4] = { x > 0 ? cell - 1 : -1, x + 1 < W ? cell + 1 : -1,
+                            y > 0 ? cell - W : -1, y + 1 < H ? cell + W : -1 };
+      for (int n : next) {
+        if (n >= 0 && isFree(n) && stamp[static_cast<size_t>(n)] != fillStamp &&
+            stamp[static_cast<size_t>(n)] != blockStamp) {
+          stamp[static_cast<size_t>(n)] = fillStamp;
+          stack.push_back(n);
+        }
+      }
+    }
+    return area;
+  };
+
+  auto force = [&](size_t p) {
+    const Placement& pl = placements[p];
+    for (int cell : pl.cells) {
+      if (occupied[static_cast<size_t>(cell)]) {
+        stats.infeasible = true;
+        stats.reason = "two forced placements overlap";
+        return;
+      }
+    }
+    forced[p] = true;
+    ++stats.forcedPlacements;
+    pieceForced[static_cast<size_t>(pl.pieceID)] = true;
+    for (int cell : pl.cells) occupied[static_cast<size_t>(cell)] = true;
+
+    for (size_t q = 0; q < placements.size(); ++q) {
+      if (!alive[q] || forced[q]) continue;
+      const Placement& other = placements[q];
+      const bool conflict = other.pieceID == pl.pieceID ||
+        std::any_of(other.cells.begin(), other.cells.end(),
+                    [&](int cell) { return occupied[static_cast<size_t>(cell)]; });
+      if (conflict) {
+        alive[q] = false;
+        ++stats.conflictingRemoved;
+      }
+    }
+  };
+
+  bool changed = true;
+  while (changed && !stats.infeasible) {
+    changed = false;
+    ++stats.rounds;
+
+    // Cells and required pieces with at most one placement left
+    std::vector<int> cellCount(numCells, 0), cellLast(numCells, -1);
+    std::vector<int> pieceCount(static_cast<size_t>(numPieces), 0), pieceLast(static_cast<size_t>(numPieces), -1);
+    for (size_t p = 0; p < placements.size(); ++p) {
+      if (!alive[p] || forced[p]) continue;
+      for (int cell : placements[p].cells) {
+        ++cellCount[static_cast<size_t>(cell)];
+        cellLast[static_cast<size_t>(cell)] = static_cast<int>(p);
+      }
+      ++pieceCount[static_cast<size_t>(placements[p].pieceID)];
+      pieceLast[static_cast<size_t>(placements[p].pieceID)] = static_cast<int>(p);
+    }
+
+    std::vector<int> toForce;
+    for (size_t cell = 0; cell < numCells && !stats.infeasible; ++cell) {
+      if (!isFree(static_cast<int>(cell))) continue;
+      if (cellCount[cell] == 0) {
+        stats.infeasible = true;
+        stats.reason = "cell (" + std::to_string(cell % W) + "," + std::to_string(cell / W) +
+                       ") cannot be covered";
+      }
+      else if (cellCount[cell] == 1) {
+        toForce.push_back(cellLast[cell]);
+      }
+    }
+    for (int k = 0; k < numPieces && !optionalPieces && !stats.infeasible; ++k) {
+      if (pieceForced[static_cast<size_t>(k)]) continue;
+      if (pieceCount[static_cast<size_t>(k)] == 0) {
+        stats.infeasible = true;
+        stats.reason = "piece " + std::to_string(k) + " has no placement left";
+      }
+      else if (pieceCount[static_cast<size_t>(k)] == 1) {
+        toForce.push_back(pieceLast[static_cast<size_t>(k)]);
+      }
+    }
+    for (int p : toForce) {
+      if (stats.infeasible) break;
+      // An earlier forced placement may have removed this one; the next
+      // round then finds its cell uncovered
+      if (!alive[static_cast<size_t>(p)] || forced[static_cast<size_t>(p)]) continue;
+      force(static_cast<size_t>(p));
+      changed = true;
+    }
+    if (stats.infeasible) break;
+
+    // Area bounds for the pieces not placed yet, with each piece left out
+    AreaBound all;
+    std::vector<AreaBound> others(static_cast<size_t>(numPieces));
+    for (int k = 0; k < numPieces; ++k) {
+      if (pieceForced[static_cast<size_t>(k)] || pieceArea[static_cast<size_t>(k)] == 0) continue;
+      all.add(pieceArea[static_cast<size_t>(k)]);
+      for (int j = 0; j < numPieces; ++j) {
+        if (j != k) others[static_cast<size_t>(j)].add(pieceArea[static_cast<size_t>(k)]);
+      }
+    }
+
+    if (nextStamp > std::numeric_limits<uint32_t>::max() - numCells - 2) {
+      std::fill(stamp.begin(), stamp.end(), 0);
+      nextStamp = 0;
+    }
+
+    // The free cells on their own must already split into fillable regions
+    const uint32_t noBlock = ++nextStamp;
+    const uint32_t boardBase = nextStamp + 1;
+    for (size_t cell = 0; cell < numCells && !stats.infeasible; ++cell) {
+      if (!isFree(static_cast<int>(cell)) || stamp[cell] >= boardBase) continue;
+      const int area = fillArea(static_cast<int>(cell), ++nextStamp, noBlock);
+      if (!all.fits(area)) {
+        stats.infeasible = true;
+        stats.reason = "a region of " + std::to_string(area) + " free cells cannot be filled";
+      }
+    }
+    if (stats.infeasible) break;
+
+    for (size_t p = 0; p < placements.size(); ++p) {
+      if (!alive[p] || forced[p]) continue;
+      if (nextStamp > std::numeric_limits<uint32_t>::max() - numCells - 2) {
+        std::fill(stamp.begin(), stamp.end(), 0);
+        nextStamp = 0;
+      }
+      const Placement& pl = placements[p];
+      const uint32_t blockStamp = ++nextStamp;
+      const uint32_t fillBase = nextStamp + 1;
+      for (int cell : pl.cells) stamp[static_cast<size_t>(cell)] = blockStamp;
+
+      const AreaBound& bound = others[static_cast<size_t>(pl.pieceID)];
+      bool dead = false;
+      for (int cell : pl.cells) {
+        const int x = cell % W, y = cell / W;
+        const int next[4] = { x > 0 ? cell - 1 : -1, x + 1 < W ? cell + 1 : -1,
+                              y > 0 ? cell - W : -1, y + 1 < H ? cell + W : -1 };
+        for (int n : next) {
+          if (n < 0 || !isFree(n)) continue;
+          const uint32_t s = stamp[static_cast<size_t>(n)];
+          if (s == blockStamp || s >= fillBase) continue;
+          if (!bound.fits(fillArea(n, ++nextStamp, blockStamp))) {
+            dead = true;
+            break;
+          }
+        }
+        if (dead) break;
+      }
+
+      if (dead) {
+        alive[p] = false;
+        ++stats.isolatingRemoved;
+        changed = true;
+      }
+    }
+  }
+
+  size_t kept = 0;
+  for (size_t p = 0; p < placements.size(); ++p) {
+    if (alive[p]) placements[kept++] = std::move(placements[p]);
+  }
+  placements.resize(kept);
+  return stats;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "shapes.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct ReductionStats
+{
+  size_t inputPlacements = 0;
+  size_t isolatingRemoved = 0;   // rows that cut off a region no other pieces can fill
+  size_t conflictingRemoved = 0; // rows that overlap a forced placement
+  size_t forcedPlacements = 0;
+  int rounds = 0;
+  bool infeasible = false;       // some cell or piece can no longer be covered
+  std::string reason;            // why, if infeasible
+};
+
+// Remove placements that cannot be part of any solution before the matrix is
+// built. Repeated until nothing changes:
+//  - a placement is dropped if, together with the cells of the forced
+//    placements, it cuts off a region of free cells whose area is below the
+//    smallest other remaining piece or not a multiple of their gcd;
+//  - a placement is forced if it is the only one left covering some cell, or
+//    the only one left for a piece that must be used; every placement that
+//    overlaps it or uses the same piece is dropped.
+// Forced placements stay in the list, so solutions are still complete. Only
+// the static mask is used, so the result holds for every search engine.
+ReductionStats reducePlacements(std::vector<Placement>& placements,
+                                const std::vector<bool>& mask,
+                                int W, int H, int numPieces, bool optionalPieces);
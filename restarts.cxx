@@ -0,0 +1,58 @@
+#include "restarts.h"
+
+#include <random>
+
+namespace
+{
+// Ends the search at the first solution and keeps its rows
+struct FirstSolutionVisitor
+{
+  FirstSolution& result;
+  const std::atomic<bool>* stop;
+
+  void onSolution(const std::vector<int>& rows) {
+    result.found = true;
+    result.rows = rows;
+  }
+  void onNode(int) { ++result.nodes; }
+  bool shouldStop() const {
+    return result.found || (stop && stop->load(std::memory_order_relaxed));
+  }
+};
+}
+
+uint64_t lubyTerm(uint64_t i)
+{
+  // Find k with 2^(k-1) <= i < 2^k; the sequence ends a block of length
+  // 2^k - 1 with 2^(k-1) and otherwise repeats the previous block
+  while (true) {
+    uint64_t k = 1;
+    while ((uint64_t{1} << k) - 1 < i) ++k;
+    if (i == (uint64_t{1} << k) - 1) return uint64_t{1} << (k - 1);
+    i -= (uint64_t{1} << (k - 1)) - 1;
+  }
+}
+
+FirstSolution findFirstSolution(DLX& dlx, uint64_t seed, uint64_t unitNodes,
+                                const std::atomic<bool>* stop)
+{
+  FirstSolution result;
+  std::mt19937_64 rng(seed);
+  FirstSolutionVisitor visitor{result, stop};
+
+  for (uint64_t run = 1; !visitor.shouldStop(); ++run) {
+    dlx.shuffleRows(rng);
+    dlx.setRandomTieBreak(rng() | 1);
+    dlx.beginSearch();
+    const bool unfinished = dlx.step(visitor, unitNodes * lubyTerm(run));
+    if (!unfinished) {
+      // Either stopped (solution or stop flag) or the whole tree was searched
+      result.exhausted = !result.found && !(stop && stop->load());
+      break;
+    }
+    dlx.abandonSearch();
+    ++result.restarts;
+  }
+  dlx.setRandomTieBreak(0);
+  return result;
+}
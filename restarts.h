@@ -0,0 +1,27 @@
+#pragma once
+
+#include "dlx.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+struct FirstSolution
+{
+  bool found = false;
+  bool exhausted = false;  // a run finished within its budget: no solution exists
+  std::vector<int> rows;
+  uint64_t nodes = 0;
+  int restarts = 0;
+};
+
+// Luby's universal restart sequence 1, 1, 2, 1, 1, 2, 4, 1, ... (i >= 1)
+uint64_t lubyTerm(uint64_t i);
+
+// Look for any one solution with randomized restarts. Every run shuffles the
+// rows of all columns, breaks column ties at random and searches for at most
+// unitNodes * lubyTerm(run) nodes before starting over. Stops at the first
+// solution, when a run completes (the puzzle has none), or when 'stop' is
+// raised. The matrix keeps the row order of the last run.
+FirstSolution findFirstSolution(DLX& dlx, uint64_t seed, uint64_t unitNodes,
+                                const std::atomic<bool>* stop);
@@ -0,0 +1,165 @@
+#include "shard.h"
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+constexpr const char* kHeader = "tessellinx-shard 3";
+
+template <typename T>
+T readField(std::istream& in, const std::string& name)
+{
+  std::string key;
+  T value{};
+  if (!(in >> key >> value) || key != name) {
+    throw std::runtime_error("Malformed shard file: expected '" + name + "'");
+  }
+  return value;
+}
+
+void expand(DLX& dlx, int depth, std::vector<int>& prefix, std::vector<std::vector<int>>& out)
+{
+  if (dlx.isSolved() || static_cast<int>(prefix.size()) == depth) {
+    out.push_back(prefix);
+    return;
+  }
+  for (int row : dlx.branchRows()) {
+    dlx.selectRow(row);
+    prefix.push_back(row);
+    expand(dlx, depth, prefix, out);
+    prefix.pop_back();
+    dlx.unselectRow(row);
+  }
+}
+}
+
+std::vector<std::vector<int>> enumeratePrefixes(DLX& dlx, int depth)
+{
+  std::vector<std::vector<int>> prefixes;
+  std::vector<int> prefix;
+  expand(dlx, std::max(0, depth), prefix, prefixes);
+  return prefixes;
+}
+
+std::vector<int> assignShards(const std::vector<double>& weights, size_t numPrefixes, int numShards)
+{
+  std::vector<int> shard(numPrefixes, 0);
+  if (weights.empty()) {
+    for (size_t k = 0; k < numPrefixes; ++k) shard[k] = static_cast<int>(k % static_cast<size_t>(numShards));
+    return shard;
+  }
+
+  std::vector<size_t> order(numPrefixes);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return weights[a] > weights[b]; });
+
+  std::vector<double> load(static_cast<size_t>(numShards), 0.0);
+  for (size_t k : order) {
+    const size_t lightest = static_cast<size_t>(std::min_element(load.begin(), load.end()) - load.begin());
+    shard[k] = static_cast<int>(lightest);
+    load[lightest] += weights[k];
+  }
+  return shard;
+}
+
+std::vector<double> estimatePrefixWeights(DLX& dlx, const std::vector<std::vector<int>>& prefixes,
+                                          int probes, uint64_t seed)
+{
+  std::vector<double> weights;
+  weights.reserve(prefixes.size());
+  for (size_t k = 0; k < prefixes.size(); ++k) {
+    std::seed_seq seq{seed, static_cast<uint64_t>(k)};
+    std::mt19937_64 rng(seq);
+    for (int row : prefixes[k]) dlx.selectRow(row);
+    double sum = 0.0;
+    for (int i = 0; i < probes; ++i) sum += dlx.probe(rng).nodes;
+    for (auto it = prefixes[k].rbegin(); it != prefixes[k].rend(); ++it) dlx.unselectRow(*it);
+    weights.push_back(std::max(1.0, sum / std::max(1, probes)));
+  }
+  return weights;
+}
+
+uint64_t splitFingerprint(const std::vector<std::vector<int>>& prefixes, const std::vector<int>& owner)
+{
+  // FNV-1a over the prefix rows, each prefix followed by its shard
+  uint64_t h = 0xCBF29CE484222325ull;
+  auto add = [&h](uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+      h ^= (v >> (8 * i)) & 0xFF;
+      h *= 0x100000001B3ull;
+    }
+  };
+  add(prefixes.size());
+  for (size_t k = 0; k < prefixes.size(); ++k) {
+    add(prefixes[k].size());
+    for (int row : prefixes[k]) add(static_cast<uint64_t>(row));
+    add(static_cast<uint64_t>(owner[k]));
+  }
+  return h;
+}
+
+void saveShardResult(const ShardResult& r, const std::filesystem::path& file)
+{
+  std::filesystem::path tmp = file;
+  tmp += ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot write shard file: " + tmp.string());
+
+    out << kHeader << "\n"
+        << "fingerprint " << r.fingerprint << "\n"
+        << "config " << r.config << "\n"
+        << "shard " << r.shard << "\n"
+        << "shards " << r.numShards << "\n"
+        << "split " << r.split << "\n"
+        << "total-prefixes " << r.totalPrefixes << "\n"
+        << "finished " << (r.finished ? 1 : 0) << "\n"
+        << "prefixes " << r.prefixes << "\n"
+        << "nodes " << r.nodesVisited << "\n"
+        << "solutions " << r.solutionsFound << "\n"
+        << "reported " << r.solutionsReported << "\n"
+        << "dedup " << (r.dedup ? 1 : 0) << "\n"
+        << "unique " << r.uniqueForms.size() << "\n";
+    for (const Fingerprint& form : r.uniqueForms) out << form << "\n";
+
+    out.flush();
+    if (!out) throw std::runtime_error("Failed writing shard file: " + tmp.string());
+  }
+  std::filesystem::rename(tmp, file);
+}
+
+ShardResult loadShardResult(const std::filesystem::path& file)
+{
+  std::ifstream in(file);
+  if (!in) throw std::runtime_error("Cannot open shard file: " + file.string());
+
+  std::string header;
+  if (!std::getline(in, header) || header != kHeader) {
+    throw std::runtime_error("Not a tessellinx shard file: " + file.string());
+  }
+
+  ShardResult r;
+  r.fingerprint = readField<uint64_t>(in, "fingerprint");
+  r.config = readField<std::string>(in, "config");
+  r.shard = readField<int>(in, "shard");
+  r.numShards = readField<int>(in, "shards");
+  r.split = readField<uint64_t>(in, "split");
+  r.totalPrefixes = readField<uint64_t>(in, "total-prefixes");
+  r.finished = readField<int>(in, "finished") != 0;
+  r.prefixes = readField<uint64_t>(in, "prefixes");
+  r.nodesVisited = readField<uint64_t>(in, "nodes");
+  r.solutionsFound = readField<uint64_t>(in, "solutions");
+  r.solutionsReported = readField<uint64_t>(in, "reported");
+  r.dedup = readField<int>(in, "dedup") != 0;
+
+  const size_t numForms = readField<size_t>(in, "unique");
+  r.uniqueForms.resize(numForms);
+  for (Fingerprint& form : r.uniqueForms) {
+    if (!(in >> form)) throw std::runtime_error("Malformed shard file: truncated dedup state");
+  }
+  return r;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "dlx.h"
+#include "fingerprint_set.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Splitting one search over independent processes. Every shard expands the
+// same search tree prefixes (rows chosen from the root down to a fixed depth)
+// and searches only the prefixes assigned to it, so the shards together
+// visit every solution exactly once without talking to each other.
+
+// Deterministic list of prefixes: rows of the branching column at each level,
+// in column order, down to 'depth' rows. Solved positions above that depth are
+// kept as shorter prefixes, dead ends are dropped. The matrix is left as it was.
+std::vector<std::vector<int>> enumeratePrefixes(DLX& dlx, int depth);
+
+// Shard (0..numShards-1) of every prefix. Without weights prefixes are dealt
+// round robin; with weights (e.g. estimated subtree sizes), the heaviest
+// prefix goes to the lightest shard first. Either way the result depends on
+// the inputs only.
+std::vector<int> assignShards(const std::vector<double>& weights, size_t numPrefixes, int numShards);
+
+// Estimated subtree size below every prefix, from 'probes' DLX probes each.
+// The random stream of prefix k depends only on (seed, k).
+std::vector<double> estimatePrefixWeights(DLX& dlx, const std::vector<std::vector<int>>& prefixes,
+                                          int probes, uint64_t seed);
+
+// Hash of the prefix list and its assignment to shards. Shards that agree on
+// it searched disjoint parts of the same split.
+uint64_t splitFingerprint(const std::vector<std::vector<int>>& prefixes, const std::vector<int>& owner);
+
+// What one shard found, as written by --shard and read by --merge-shards
+struct ShardResult
+{
+  uint64_t fingerprint = 0;   // puzzleFingerprint() of the run
+  std::string config;         // split settings; must match between shards
+  int shard = 0;
+  int numShards = 1;
+  uint64_t split = 0;         // splitFingerprint() of the split
+  uint64_t totalPrefixes = 0; // prefixes of all shards together
+  uint64_t prefixes = 0;      // prefixes searched by this shard
+  uint64_t nodesVisited = 0;
+  uint64_t solutionsFound = 0;
+  uint64_t solutionsReported = 0;          // after the unique-solutions filter
+  std::vector<Fingerprint> uniqueForms;    // canonical form fingerprints, if deduplicating
+  bool dedup = false;
+  bool finished = true;       // false if the shard was stopped early
+};
+
+// Written to a temporary file and renamed over 'file'
+void saveShardResult(const ShardResult& r, const std::filesystem::path& file);
+
+// Throws std::runtime_error if the file is missing or malformed
+ShardResult loadShardResult(const std::filesystem::path& file);
@@ -0,0 +1,125 @@
+#include "symmetry.h"
+
+#include <algorithm>
+#include <map>
+
+void transformCoord(int x, int y, int W, int H, SymmetryOp op, int& nx, int& ny)
+{
+  switch (op) {
+  case ROT_0:     nx = x;         ny = y;         break;
+  case ROT_90:    nx = H - 1 - y; ny = x;         break;
+  case ROT_180:   nx = W - 1 - x; ny = H - 1 - y; break;
+  case ROT_270:   nx = y;         ny = W - 1 - x; break;
+  case REFLECT_X: nx = W - 1 - x; ny = y;         break;
+  case REFLECT_Y: nx = x;         ny = H - 1 - y; break;
+  case REFLECT_D1: nx = y;        ny = x;         break;
+  case REFLECT_D2: nx = H - 1 - y; ny = W - 1 - x; break;
+  }
+}
+
+bool swapsAxes(SymmetryOp op)
+{
+  return op == ROT_90 || op == ROT_270 || op == REFLECT_D1 || op == REFLECT_D2;
+}
+
+std::vector<SymmetryOp> boardSymmetries(const std::vector<bool>& mask, int W, int H)
+{
+  static const SymmetryOp ops[] = {
+    ROT_0, ROT_90, ROT_180, ROT_270,
+    REFLECT_X, REFLECT_Y, REFLECT_D1, REFLECT_D2
+  };
+
+  std::vector<SymmetryOp> group;
+  for (SymmetryOp op : ops) {
+    if (swapsAxes(op) && W != H) continue;
+
+    bool preserved = true;
+    for (int y = 0; y < H && preserved; ++y) {
+      for (int x = 0; x < W; ++x) {
+        int nx, ny;
+        transformCoord(x, y, W, H, op, nx, ny);
+        if (mask[y * W + x] != mask[ny * W + nx]) {
+          preserved = false;
+          break;
+        }
+      }
+    }
+    if (preserved) group.push_back(op);
+  }
+  return group;
+}
+
+std::vector<int> previousCopies(const std::vector<Piece>& pieces)
+{
+  // The smallest normalized orientation identifies a free shape
+  std::map<Shape, int> lastOfShape;
+  std::vector<int> prev(pieces.size(), -1);
+  for (size_t p = 0; p < pieces.size(); ++p) {
+    const std::vector<Shape> transforms = generateTransforms(pieces[p].shape);
+    auto [it, inserted] = lastOfShape.try_emplace(*std::min_element(transforms.begin(), transforms.end()),
+                                                  static_cast<int>(p));
+    if (!inserted) {
+      prev[p] = it->second;
+      it->second = static_cast<int>(p);
+    }
+  }
+  return prev;
+}
+
+SymmetryBreak breakBoardSymmetry(std::vector<Placement>& placements,
+                                 const std::vector<Piece>& pieces,
+                                 const std::vector<bool>& mask,
+                                 int W, int H)
+{
+  SymmetryBreak result;
+  const std::vector<SymmetryOp> group = boardSymmetries(mask, W, H);
+  result.groupSize = static_cast<int>(group.size());
+  if (group.size() < 2) return result;
+
+  // Of the fully asymmetric pieces, restrict the one with most placements
+  std::vector<size_t> placementsPerPiece(pieces.size(), 0);
+  for (const Placement& pl : placements) {
+    placementsPerPiece[static_cast<size_t>(pl.pieceID)]++;
+  }
+  const std::vector<int> prev = previousCopies(pieces);
+  std::vector<bool> hasCopies(pieces.size(), false);
+  for (size_t p = 0; p < pieces.size(); ++p) {
+    if (prev[p] < 0) continue;
+    hasCopies[p] = true;
+    hasCopies[static_cast<size_t>(prev[p])] = true;
+  }
+  for (size_t p = 0; p < pieces.size(); ++p) {
+    if (hasCopies[p] || generateTransforms(pieces[p].shape).size() != 8) continue;
+    if (result.pieceID < 0 || placementsPerPiece[p] > placementsPerPiece[static_cast<size_t>(result.pieceID)]) {
+      result.pieceID = static_cast<int>(p);
+    }
+  }
+  if (result.pieceID < 0) return result;
+
+  // A placement survives if no symmetric image of it sorts before it
+  auto isOrbitRepresentative = [&](const Placement& pl) {
+    std::vector<int> cells = pl.cells;
+    std::sort(cells.begin(), cells.end());
+
+    std::vector<int> image(cells.size());
+    for (SymmetryOp op : group) {
+      for (size_t i = 0; i < cells.size(); ++i) {
+        int nx, ny;
+        transformCoord(cells[i] % W, cells[i] / W, W, H, op, nx, ny);
+        image[i] = ny * W + nx;
+      }
+      std::sort(image.begin(), image.end());
+      if (image < cells) return false;
+    }
+    return true;
+  };
+
+  const size_t before = placements.size();
+  placements.erase(std::remove_if(placements.begin(), placements.end(),
+                                  [&](const Placement& pl) {
+                                    return pl.pieceID == result.pieceID && !isOrbitRepresentative(pl);
+                                  }),
+                   placements.end());
+  result.removedPlacements = before - placements.size();
+  return result;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "shapes.h"
+
+#include <cstddef>
+#include <vector>
+
+enum SymmetryOp {
+  ROT_0,
+  ROT_90,
+  ROT_180,
+  ROT_270,
+  REFLECT_X,   // horizontal flip (mirror over vertical axis)
+  REFLECT_Y,   // vertical flip (mirror over horizontal axis)
+  REFLECT_D1,  // reflect over main diagonal (y = x)
+  REFLECT_D2   // reflect over anti-diagonal (y = -x)
+};
+
+// Apply a symmetry to (x, y) coordinates
+void transformCoord(int x, int y, int W, int H, SymmetryOp op, int& nx, int& ny);
+
+// True for the ops that exchange width and height
+bool swapsAxes(SymmetryOp op);
+
+// Ops that map the board mask onto itself (axis-swapping ops only on square
+// boards). Always contains ROT_0.
+std::vector<SymmetryOp> boardSymmetries(const std::vector<bool>& mask, int W, int H);
+
+// For every piece, the previous piece of the same shape (-1 if none), so
+// identical pieces form chains of copies
+std::vector<int> previousCopies(const std::vector<Piece>& pieces);
+
+struct SymmetryBreak
+{
+  int groupSize = 1;        // number of board symmetries
+  int pieceID = -1;         // restricted piece, -1 if none
+  size_t removedPlacements = 0;
+};
+
+// Keep only the first placement of each orbit under the board symmetries for
+// one piece without symmetries of its own (8 distinct orientations) and
+// without identical copies, whose order is fixed separately. No
+// symmetry maps such a placement onto itself, so every orbit of solutions
+// keeps exactly one member and mirror-image subtrees are never searched.
+SymmetryBreak breakBoardSymmetry(std::vector<Placement>& placements,
+                                 const std::vector<Piece>& pieces,
+                                 const std::vector<bool>& mask,
+                                 int W, int H);
@@ -0,0 +1,56 @@
+#include "../fingerprint_set.h"
+
+#include <iostream>
+#include <string>
+
+namespace
+{
+int failures = 0;
+
+void check(bool ok, const char* what)
+{
+  if (!ok) {
+    std::cerr << "FAILED: " << what << "\n";
+    ++failures;
+  }
+}
+
+// Two forms forced onto the same fingerprint: the second is a new entry and
+// one collision, however often it is inserted again
+void testCollisionCountedOncePerForm()
+{
+  FingerprintSet set;
+  set.setVerify(true);
+  const Fingerprint fp{0x0123456789ABCDEFull, 42};
+  const std::string a = "form A", b = "form B";
+
+  check(set.insert(fp, &a), "first form is new");
+  check(!set.insert(fp, &a), "first form again is a duplicate");
+  check(set.collisions() == 0, "no collision before a second form");
+
+  check(set.insert(fp, &b), "second form with the same fingerprint is new");
+  check(set.collisions() == 1, "second form counts one collision");
+  check(!set.insert(fp, &b), "second form again is a duplicate");
+  check(!set.insert(fp, &b), "second form a third time is a duplicate");
+  check(set.collisions() == 1, "repeats of the second form add no collisions");
+  check(set.size() == 2, "both forms are stored");
+}
+
+void testWithoutVerification()
+{
+  FingerprintSet set;
+  check(set.insert(std::string("form A")), "form is new");
+  check(!set.insert(std::string("form A")), "same form is a duplicate");
+  check(set.insert(std::string("form B")), "other form is new");
+  check(set.size() == 2 && set.collisions() == 0, "two entries, no collisions");
+}
+}
+
+int main()
+{
+  testCollisionCountedOncePerForm();
+  testWithoutVerification();
+  if (failures) return 1;
+  std::cout << "fingerprint_set: all tests passed\n";
+  return 0;
+}
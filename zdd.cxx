@@ -0,0 +1,190 @@
+#include "zdd.h"
+
+#include "bounded_draw.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+constexpr char kMagic[8] = {'T', 'L', 'X', 'Z', 'D', 'D', '0', '2'};
+
+template <typename T>
+void writeValue(std::ofstream& out, T value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T readValue(std::ifstream& in)
+{
+  T value{};
+  if (!in.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+    throw std::runtime_error("Truncated ZDD file");
+  }
+  return value;
+}
+
+uint64_t saturatingAdd(uint64_t a, uint64_t b)
+{
+  return (a > std::numeric_limits<uint64_t>::max() - b) ? std::numeric_limits<uint64_t>::max() : a + b;
+}
+}
+
+ZDD::ZDD()
+{
+  // Terminals: their var sorts after every real variable
+  const uint32_t terminalVar = std::numeric_limits<uint32_t>::max();
+  m_nodes.push_back({terminalVar, kEmpty, kEmpty});
+  m_nodes.push_back({terminalVar, kUnit, kUnit});
+}
+
+void ZDD::setVariables(std::vector<int> varRows, size_t numPlacements)
+{
+  m_varRows = std::move(varRows);
+  m_numPlacements = numPlacements;
+}
+
+ZDD::NodeID ZDD::makeNode(uint32_t var, NodeID lo, NodeID hi)
+{
+  if (hi == kEmpty) return lo;
+
+  const NodeKey key{var, lo, hi};
+  const auto it = m_unique.find(key);
+  if (it != m_unique.end()) return it->second;
+
+  const NodeID id = static_cast<NodeID>(m_nodes.size());
+  m_nodes.push_back({var, lo, hi});
+  m_unique.emplace(key, id);
+  m_counts.clear();
+  return id;
+}
+
+const std::vector<uint64_t>& ZDD::counts() const
+{
+  if (m_counts.size() == m_nodes.size()) return m_counts;
+
+  // Children always have smaller IDs than their parents
+  m_counts.assign(m_nodes.size(), 0);
+  m_counts[kUnit] = 1;
+  for (size_t id = 2; id < m_nodes.size(); ++id) {
+    m_counts[id] = saturatingAdd(m_counts[m_nodes[id].lo], m_counts[m_nodes[id].hi]);
+  }
+  return m_counts;
+}
+
+uint64_t ZDD::count() const
+{
+  return counts()[m_root];
+}
+
+std::vector<int> ZDD::sample(std::mt19937_64& rng) const
+{
+  const std::vector<uint64_t>& c = counts();
+  std::vector<int> rows;
+  if (c[m_root] == 0) return rows;
+  // Saturated counts no longer give the right branch odds
+  if (c[m_root] == std::numeric_limits<uint64_t>::max()) {
+    throw std::runtime_error("Cannot sample: the ZDD has too many solutions to count exactly");
+  }
+
+  NodeID id = m_root;
+  while (id > kUnit) {
+    const Node& n = m_nodes[id];
+    if (boundedDraw(rng, c[id]) < c[n.hi]) {
+      rows.push_back(m_varRows[n.var]);
+      id = n.hi;
+    }
+    else {
+      id = n.lo;
+    }
+  }
+  return rows;
+}
+
+void ZDD::enumerate(const std::function<bool(const std::vector<int>&)>& visit) const
+{
+  std::vector<int> rows;
+  bool keepGoing = true;
+
+  std::function<void(NodeID)> walk = [&](NodeID id) {
+    if (!keepGoing || id == kEmpty) return;
+    if (id == kUnit) {
+      keepGoing = visit(rows);
+      return;
+    }
+    const Node& n = m_nodes[id];
+    rows.push_back(m_varRows[n.var]);
+    walk(n.hi);
+    rows.pop_back();
+    walk(n.lo);
+  };
+
+  walk(m_root);
+}
+
+void ZDD::save(const std::filesystem::path& file) const
+{
+  std::ofstream out(file, std::ios::binary);
+  if (!out) throw std::runtime_error("Cannot open ZDD file for writing: " + file.string());
+
+  out.write(kMagic, sizeof(kMagic));
+  writeValue<uint64_t>(out, m_fingerprint);
+  writeValue<uint64_t>(out, m_numPlacements);
+  writeValue<uint32_t>(out, static_cast<uint32_t>(m_varRows.size()));
+  writeValue<uint32_t>(out, static_cast<uint32_t>(m_nodes.size()));
+  writeValue<uint32_t>(out, m_root);
+  for (int row : m_varRows) {
+    writeValue<int32_t>(out, row);
+  }
+  for (size_t id = 2; id < m_nodes.size(); ++id) {
+    writeValue<uint32_t>(out, m_nodes[id].var);
+    writeValue<uint32_t>(out, m_nodes[id].lo);
+    writeValue<uint32_t>(out, m_nodes[id].hi);
+  }
+  if (!out) throw std::runtime_error("Failed writing ZDD file: " + file.string());
+}
+
+ZDD ZDD::load(const std::filesystem::path& file)
+{
+  std::ifstream in(file, std::ios::binary);
+  if (!in) throw std::runtime_error("Cannot open ZDD file: " + file.string());
+
+  char magic[sizeof(kMagic)];
+  if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), kMagic)) {
+    throw std::runtime_error("Not a tessellinx ZDD file: " + file.string());
+  }
+
+  ZDD zdd;
+  zdd.m_fingerprint = readValue<uint64_t>(in);
+  zdd.m_numPlacements = static_cast<size_t>(readValue<uint64_t>(in));
+  const uint32_t numVars = readValue<uint32_t>(in);
+  const uint32_t numNodes = readValue<uint32_t>(in);
+  zdd.m_root = readValue<uint32_t>(in);
+  if (numNodes < 2 || zdd.m_root >= numNodes) {
+    throw std::runtime_error("Corrupt ZDD header: " + file.string());
+  }
+
+  zdd.m_varRows.resize(numVars);
+  for (uint32_t v = 0; v < numVars; ++v) {
+    zdd.m_varRows[v] = readValue<int32_t>(in);
+    if (zdd.m_varRows[v] < 0 || static_cast<size_t>(zdd.m_varRows[v]) >= zdd.m_numPlacements) {
+      throw std::runtime_error("Corrupt ZDD variable table in " + file.string());
+    }
+  }
+
+  zdd.m_nodes.reserve(numNodes);
+  for (uint32_t id = 2; id < numNodes; ++id) {
+    Node n;
+    n.var = readValue<uint32_t>(in);
+    n.lo = readValue<uint32_t>(in);
+    n.hi = readValue<uint32_t>(in);
+    if (n.var >= numVars || n.lo >= id || n.hi >= id) {
+      throw std::runtime_error("Corrupt ZDD node in " + file.string());
+    }
+    zdd.m_nodes.push_back(n);
+  }
+  return zdd;
+}
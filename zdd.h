@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Zero-suppressed decision diagram over placement variables.
+// Node 0 is the empty family, node 1 is the family holding only the empty set.
+// Every other node (var, lo, hi) stands for lo + {var} x hi, with variables
+// strictly increasing along every path. Variables map to DLX row IDs
+// (placement indices), so each path to node 1 is one solution.
+class ZDD
+{
+public:
+  using NodeID = uint32_t;
+  static constexpr NodeID kEmpty = 0;
+  static constexpr NodeID kUnit = 1;
+
+  struct Node
+  {
+    uint32_t var;
+    NodeID lo;
+    NodeID hi;
+  };
+
+  ZDD();
+
+  // Row ID of each variable; must be set before nodes are made
+  void setVariables(std::vector<int> varRows, size_t numPlacements);
+
+  // Hash-consed node constructor; applies the zero-suppression rule
+  NodeID makeNode(uint32_t var, NodeID lo, NodeID hi);
+
+  void setRoot(NodeID root) { m_root = root; }
+  NodeID root() const { return m_root; }
+
+  size_t numNodes() const { return m_nodes.size(); }
+  size_t numPlacements() const { return m_numPlacements; }
+
+  // puzzleFingerprint() of the puzzle the ZDD was built for, saved with it
+  void setFingerprint(uint64_t fingerprint) { m_fingerprint = fingerprint; }
+  uint64_t fingerprint() const { return m_fingerprint; }
+
+  // Number of solutions (saturates at UINT64_MAX)
+  uint64_t count() const;
+
+  // Solutions drawn uniformly at random, the same for a given seed on every
+  // platform. Throws std::runtime_error if count() saturated.
+  std::vector<int> sample(std::mt19937_64& rng) const;
+
+  // Visit every solution; stop early when the callback returns false
+  void enumerate(const std::function<bool(const std::vector<int>&)>& visit) const;
+
+  // Binary file I/O; load() throws std::runtime_error on malformed files
+  void save(const std::filesystem::path& file) const;
+  static ZDD load(const std::filesystem::path& file);
+
+private:
+  struct NodeKey
+  {
+    uint32_t var;
+    NodeID lo;
+    NodeID hi;
+    bool operator==(const NodeKey& o) const { return var == o.var && lo == o.lo && hi == o.hi; }
+  };
+
+  struct NodeKeyHash
+  {
+    size_t operator()(const NodeKey& k) const {
+      uint64_t h = (uint64_t{k.var} << 32) ^ k.lo;
+      h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+      h ^= uint64_t{k.hi} * 0x94D049BB133111EBull;
+      return static_cast<size_t>(h ^ (h >> 31));
+    }
+  };
+
+  std::vector<Node> m_nodes;
+  std::vector<int> m_varRows;
+  size_t m_numPlacements = 0;
+  uint64_t m_fingerprint = 0;
+  NodeID m_root = kEmpty;
+  std::unordered_map<NodeKey, NodeID, NodeKeyHash> m_unique;
+
+  // Per-node solution counts, computed on demand
+  mutable std::vector<uint64_t> m_counts;
+  const std::vector<uint64_t>& counts() const;
+};